@@ -1,70 +1,260 @@
 #include "afn.h"
 
 // -----------------------------------------------------------------------------
-int linear_scan(					// k-FN search of linear scan
+static FILE *open_latency(			// open latency dump (if required)
+	const char *name,					// name of algorithm
+	const char *out_path)				// output path
+{
+	if (!g_dump_latency) return NULL;
+
+	char latency_set[200]; 
+	sprintf(latency_set, "%s%s_latency.out", out_path, name);
+	FILE *lfp = fopen(latency_set, "a+");
+	if (!lfp) printf("Could not create %s\n", latency_set);
+	return lfp;
+}
+
+// -----------------------------------------------------------------------------
+static void report(					// report the results of one top-k value
+	int   top_k,						// top-k value
+	int   qn,							// number of query objects
+	float runtime,						// average running time (ms)
+	double *lat,						// per-query latency (ms)
+	FILE  *fp,							// output file
+	FILE  *lfp)							// latency dump (NULL: no dump)
+{
+	if (lfp) {
+		for (int i = 0; i < qn; ++i) {
+			fprintf(lfp, "%d\t%d\t%f\n", top_k, i, lat[i]);
+		}
+	}
+	Latency res;
+	calc_latency(qn, lat, res);
+
+	g_ratio    = g_ratio    / qn;
+	g_recall   = g_recall   / qn;
+	g_fraction = g_fraction / qn;
+	g_runtime  = runtime;
+
+	printf("%3d\t\t%.4f\t\t%.4f\t\t%.2f%%\t\t%.2f%%\t\t"
+		"%.3f\t%.3f\t%.3f\t%.3f\t%.3f\t%.3f\n", top_k, g_ratio, g_runtime, 
+		g_recall, g_fraction, res.min_, res.p50_, res.p90_, res.p99_, 
+		res.p999_, res.max_);
+	fprintf(fp, "%d\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\t%f\n", 
+		top_k, g_ratio, g_runtime, g_recall, g_fraction, res.min_, 
+		res.p50_, res.p90_, res.p99_, res.p999_, res.max_);
+}
+
+// -----------------------------------------------------------------------------
+//  c-k-AFN search for all top-k values: each query is timed individually with 
+//  a monotonic clock, and the evaluation (ratio, recall) is not timed
+// -----------------------------------------------------------------------------
+template<class KFN>
+static int kfn_search(				// c-k-AFN search with per-query latency
 	int   n,							// number of data objects
 	int   qn,							// number of query objects
 	int   d,							// dimensionality
-	const float *data,					// data set
+	const char  *name,					// name of algorithm (for latency dump)
 	const float *query,					// query set
-	const Result *R, 					// truth set
-	const char *out_path)				// output path
+	const Result *R,					// truth set
+	const char  *out_path,				// output path
+	FILE  *fp,							// output file
+	KFN   kfn)							// c-k-AFN search
 {
-	char output_set[200]; sprintf(output_set, "%slinear.out", out_path);
-	FILE *fp = fopen(output_set, "a+");
-	if (!fp) { printf("Could not create %s\n", output_set); return 1; }
-
-	// -------------------------------------------------------------------------
-	//  c-k-AFN search
-	// -------------------------------------------------------------------------
-	fprintf(fp, "Linear Scan:\n");
-
-	printf("Top-k FN Search of Linear Scan:\n");
-	printf("Top-k\t\tRatio\t\tTime (ms)\tRecall (%)\tFraction (%)\n");
+	FILE *lfp = open_latency(name, out_path);
+	if (g_dump_latency && !lfp) return 1;
+	begin_mem_phase(MEM_QUERY);
+	TRACE_BEGIN("query", qn);
+
+	printf("Top-k\t\tRatio\t\tTime (ms)\tRecall (%)\tFraction (%)\t"
+		"Min\tP50\tP90\tP99\tP99.9\tMax\n");
+	double *lat = new double[qn];
 	for (int num = 0; num < MAX_ROUND; ++num) {
-		gettimeofday(&g_start_time, NULL);
 		int top_k = TOPK[num];
+		TRACE_SCOPE("top-k", top_k);
 		MaxK_List *list = new MaxK_List(top_k);
 		
 		g_ratio    = 0.0f;
 		g_recall   = 0.0f;
 		g_fraction = 0.0f;
+		double runtime = 0.0;
 		for (int i = 0; i < qn; ++i) {
+			TRACE_SCOPE("kfn", i);
 			list->reset();
-			int check_k = k_fn_search(n, d, data, &query[i*d], list);
-
-			float ratio = 0.0f;
-			for (int j = 0; j < top_k; ++j) {
-				if (fabs(list->ith_key(j) - R[i*MAXK+j].key_) < CHECK_ERROR) 
-					ratio += 1.0f;
-				else 
-					ratio += R[i*MAXK+j].key_ / list->ith_key(j);
-			}
-			g_ratio    += ratio / top_k;
+			double start = get_cur_time();
+			int check_k = kfn(top_k, &query[i*d], list);
+			lat[i] = get_cur_time() - start;
+			runtime += lat[i];
+
+			g_ratio    += calc_ratio(top_k, &R[i*MAXK], list);
 			g_recall   += calc_recall(top_k, &R[i*MAXK], list);
 			g_fraction += check_k * 100.0f / n;
 		}
 		delete list; list = NULL;
-		gettimeofday(&g_end_time, NULL);
-		g_runtime = g_end_time.tv_sec - g_start_time.tv_sec + 
-			(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
-
-		g_ratio    = g_ratio    / qn;
-		g_recall   = g_recall   / qn;
-		g_fraction = g_fraction / qn;
-		g_runtime  = (g_runtime * 1000.0f) / qn;
-
-		printf("%3d\t\t%.4f\t\t%.4f\t\t%.2f%%\t\t%.2f%%\n", top_k, g_ratio, 
-			g_runtime, g_recall, g_fraction);
-		fprintf(fp, "%d\t%f\t%f\t%f\t%f\n", top_k, g_ratio, g_runtime, 
-			g_recall, g_fraction);
+		report(top_k, qn, (float) (runtime / qn), lat, fp, lfp);
 	}
 	printf("\n");
 	fprintf(fp, "\n");
+	delete[] lat; lat = NULL;
+	if (lfp) fclose(lfp);
+
+	TRACE_END();
+	end_mem_phase(MEM_QUERY);
+	display_mem(fp);
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+//  c-k-AFN search for all top-k values, where groups of g_group queries are 
+//  interleaved on one core: the latency of a query is the time until its 
+//  group is finished, and the running time is the time per query
+// -----------------------------------------------------------------------------
+template<class KFN_GROUP>
+static int kfn_search_group(		// interleaved c-k-AFN search
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	const char  *name,					// name of algorithm (for latency dump)
+	const float *query,					// query set
+	const Result *R,					// truth set
+	const char  *out_path,				// output path
+	FILE  *fp,							// output file
+	KFN_GROUP kfn_group)				// interleaved c-k-AFN search
+{
+	FILE *lfp = open_latency(name, out_path);
+	if (g_dump_latency && !lfp) return 1;
+	begin_mem_phase(MEM_QUERY);
+	TRACE_BEGIN("query", qn);
+
+	printf("Top-k\t\tRatio\t\tTime (ms)\tRecall (%)\tFraction (%)\t"
+		"Min\tP50\tP90\tP99\tP99.9\tMax\n");
+	int    group = g_group;
+	double *lat  = new double[qn];
+	int    *check_k = new int[group];
+	const float **q = new const float*[group];
+	MaxK_List   **list = new MaxK_List*[group];
+
+	for (int num = 0; num < MAX_ROUND; ++num) {
+		int top_k = TOPK[num];
+		TRACE_SCOPE("top-k", top_k);
+		for (int j = 0; j < group; ++j) list[j] = new MaxK_List(top_k);
+		
+		g_ratio    = 0.0f;
+		g_recall   = 0.0f;
+		g_fraction = 0.0f;
+		double runtime = 0.0;
+		for (int i = 0; i < qn; i += group) {
+			TRACE_SCOPE("kfn_group", i);
+			int g_num = MIN(group, qn - i);
+			for (int j = 0; j < g_num; ++j) {
+				list[j]->reset();
+				q[j] = &query[(i+j)*d];
+			}
+			double start = get_cur_time();
+			kfn_group(top_k, g_num, q, list, check_k);
+			double elapsed = get_cur_time() - start;
+			runtime += elapsed;
+
+			for (int j = 0; j < g_num; ++j) {
+				lat[i+j]    = elapsed;
+				g_ratio    += calc_ratio(top_k, &R[(i+j)*MAXK], list[j]);
+				g_recall   += calc_recall(top_k, &R[(i+j)*MAXK], list[j]);
+				g_fraction += check_k[j] * 100.0f / n;
+			}
+		}
+		for (int j = 0; j < group; ++j) { delete list[j]; list[j] = NULL; }
+		report(top_k, qn, (float) (runtime / qn), lat, fp, lfp);
+	}
+	printf("\n");
+	fprintf(fp, "\n");
+	delete[] lat;
+	delete[] check_k;
+	delete[] q;
+	delete[] list;
+	if (lfp) fclose(lfp);
+
+	TRACE_END();
+	end_mem_phase(MEM_QUERY);
+	display_mem(fp);
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+static double get_deadline()		// deadline of the query starting now
+{
+	return g_deadline > 0.0f ? get_cur_time() + g_deadline : 0.0;
+}
+
+// -----------------------------------------------------------------------------
+static void report_anytime(			// report the queries cut short
+	int   qn,							// number of query objects
+	int   cut,							// number of searches cut short
+	FILE  *fp)							// output file
+{
+	float ratio = cut * 100.0f / (qn * MAX_ROUND);
+	printf("Cut Short: %.2f%% (budget = %d, deadline = %.3f ms)\n\n", ratio, 
+		g_budget, g_deadline);
+	fprintf(fp, "Cut Short: %f%% (budget = %d, deadline = %f ms)\n\n", ratio,
+		g_budget, g_deadline);
+}
+
+#ifdef RQALSH_STATS
+// -----------------------------------------------------------------------------
+//  search statistics accumulated over all top-k values
+// -----------------------------------------------------------------------------
+template<class INDEX>
+static int output_stats(			// display and export search statistics
+	const char *name,					// name of algorithm
+	const char *out_path,				// output path
+	INDEX *index)						// index with search statistics
+{
+	char stats_set[200]; sprintf(stats_set, "%s%s_stats.out", out_path, name);
+	FILE *fp = fopen(stats_set, "a+");
+	if (!fp) { printf("Could not create %s\n", stats_set); return 1; }
+
+	printf("Search Statistics of %s:\n", name);
+	display_stats_header(stdout);
+	index->display_stats(stdout);
+	printf("\n");
+
+	display_stats_header(fp);
+	index->display_stats(fp);
+	fprintf(fp, "\n");
 	fclose(fp);
-	
+
 	return 0;
 }
+#endif
+
+// -----------------------------------------------------------------------------
+int linear_scan(					// k-FN search of linear scan
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	const float *data,					// data set
+	const float *query,					// query set
+	const Result *R, 					// truth set
+	const char *out_path)				// output path
+{
+	char output_set[200]; sprintf(output_set, "%slinear.out", out_path);
+	FILE *fp = fopen(output_set, "a+");
+	if (!fp) { printf("Could not create %s\n", output_set); return 1; }
+
+	// -------------------------------------------------------------------------
+	//  c-k-AFN search
+	// -------------------------------------------------------------------------
+	fprintf(fp, "Linear Scan:\n");
+
+	printf("Top-k FN Search of Linear Scan:\n");
+	int ret = kfn_search(n, qn, d, "linear", query, R, out_path, fp, 
+		[&](int /*k*/, const float *q, MaxK_List *list) {
+			return k_fn_search(n, d, data, q, list); });
+	fclose(fp);
+	
+	return ret;
+}
 
 // -----------------------------------------------------------------------------
 int qdafn(							// c-k-AFN search of QDAFN
@@ -74,7 +264,8 @@ int qdafn(							// c-k-AFN search of QDAFN
 	int   L,							// number of projections
 	int   M,							// number of candidates
 	float ratio,						// approximation ratio
-	const float *data,					// data set
+	const char *data_set,				// address of data set
+	float *data,						// data set (read here if g_stream)
 	const float *query,					// query set
 	const Result *R, 					// truth set
 	const char *out_path)				// output path
@@ -86,14 +277,24 @@ int qdafn(							// c-k-AFN search of QDAFN
 	// -------------------------------------------------------------------------
 	//  indexing 
 	// -------------------------------------------------------------------------
+	begin_mem_phase(MEM_BUILD);
+	TRACE_BEGIN("build", n);
 	gettimeofday(&g_start_time, NULL);
-	QDAFN *hash = new QDAFN(n, d, L, M, 2, ratio, data);
+	QDAFN *hash = NULL;
+	if (g_stream) {
+		hash = new QDAFN(n, d, L, M, 2, ratio, data_set, data, MAGIC, g_proj);
+	}
+	else {
+		hash = new QDAFN(n, d, L, M, 2, ratio, data, MAGIC, g_proj);
+	}
 	hash->display();
 
 	gettimeofday(&g_end_time, NULL);
 	g_indextime = g_end_time.tv_sec - g_start_time.tv_sec + 
 		(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
 	g_memory = hash->get_memory_usage() / 1048576.0f;
+	TRACE_END();
+	end_mem_phase(MEM_BUILD);
 	
 	printf("Indexing Time = %f Seconds\n", g_indextime);
 	printf("Memory = %f MB\n\n", g_memory);
@@ -106,52 +307,13 @@ int qdafn(							// c-k-AFN search of QDAFN
 	//  c-k-AFN search of QDAFN
 	// -------------------------------------------------------------------------
 	printf("Top-k FN Search of QDAFN: \n");
-	printf("Top-k\t\tRatio\t\tTime (ms)\tRecall (%)\tFraction (%)\n");	
-	for (int num = 0; num < MAX_ROUND; ++num) {
-		gettimeofday(&g_start_time, NULL);
-		int top_k = TOPK[num];
-		MaxK_List *list = new MaxK_List(top_k);
-
-		g_ratio    = 0.0f;
-		g_recall   = 0.0f;
-		g_fraction = 0.0f;
-		for (int i = 0; i < qn; ++i) {
-			list->reset();
-			int check_k = hash->kfn(top_k, &query[i*d], list);
-
-			float ratio = 0.0f;
-			for (int j = 0; j < top_k; ++j) {
-				if (fabs(list->ith_key(j) - R[i*MAXK+j].key_) < CHECK_ERROR) 
-					ratio += 1.0f;
-				else 
-					ratio += R[i*MAXK+j].key_ / list->ith_key(j);
-			}
-			g_ratio    += ratio / top_k;
-			g_recall   += calc_recall(top_k, &R[i*MAXK], list);
-			g_fraction += check_k * 100.0f / n;
-
-		}
-		delete list; list = NULL;
-		gettimeofday(&g_end_time, NULL);
-		g_runtime = g_end_time.tv_sec - g_start_time.tv_sec + 
-			(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
-
-		g_ratio    = g_ratio    / qn;
-		g_recall   = g_recall   / qn;
-		g_fraction = g_fraction / qn;
-		g_runtime  = (g_runtime * 1000.0f) / qn;
-
-		printf("%3d\t\t%.4f\t\t%.4f\t\t%.2f%%\t\t%.2f%%\n", top_k, g_ratio, 
-			g_runtime, g_recall, g_fraction);
-		fprintf(fp, "%d\t%f\t%f\t%f\t%f\n", top_k, g_ratio, g_runtime, 
-			g_recall, g_fraction);
-	}
-	printf("\n");
-	fprintf(fp, "\n");
+	int ret = kfn_search(n, qn, d, "qdafn", query, R, out_path, fp, 
+		[&](int k, const float *q, MaxK_List *list) {
+			return hash->kfn(k, q, list); });
 	fclose(fp);
 	delete hash;
 
-	return 0;
+	return ret;
 }
 
 // -----------------------------------------------------------------------------
@@ -161,6 +323,8 @@ int drusilla_select(				// c-k-AFN search of Drusilla-Select
 	int   d,							// number of dimensions
 	int   L,							// number of projections
 	int   M,							// number of candidates
+	bool  fold,							// fold centering into the math?
+	bool  packed,						// pack candidates contiguously?
 	const float *data,					// data set
 	const float *query,					// query set
 	const Result *R, 					// truth set
@@ -174,14 +338,18 @@ int drusilla_select(				// c-k-AFN search of Drusilla-Select
 	// -------------------------------------------------------------------------
 	//  indexing
 	// -------------------------------------------------------------------------
+	begin_mem_phase(MEM_BUILD);
+	TRACE_BEGIN("build", n);
 	gettimeofday(&g_start_time, NULL);
-	Drusilla_Select *drusilla = new Drusilla_Select(n, d, L, M, data);
+	Drusilla_Select *drusilla = new Drusilla_Select(n, d, L, M, fold, packed, data);
 	drusilla->display();
 
 	gettimeofday(&g_end_time, NULL);
 	g_indextime = g_end_time.tv_sec - g_start_time.tv_sec + 
 		(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
 	g_memory = drusilla->get_memory_usage() / 1048576.0f;
+	TRACE_END();
+	end_mem_phase(MEM_BUILD);
 
 	printf("Indexing Time = %f Seconds\n", g_indextime);
 	printf("Memory = %f MB\n\n", g_memory);
@@ -194,51 +362,13 @@ int drusilla_select(				// c-k-AFN search of Drusilla-Select
 	//  c-k-AFN search of Drusilla-Select
 	// -------------------------------------------------------------------------
 	printf("Top-k FN Search of Drusilla-Select: \n");
-	printf("Top-k\t\tRatio\t\tTime (ms)\tRecall (%)\tFraction (%)\n");
-	for (int num = 0; num < MAX_ROUND; ++num) {
-		gettimeofday(&g_start_time, NULL);
-		int top_k = TOPK[num];
-		MaxK_List *list = new MaxK_List(top_k);
-
-		g_ratio    = 0.0f;
-		g_recall   = 0.0f;
-		g_fraction = 0.0f;
-		for (int i = 0; i < qn; ++i) {
-			list->reset();
-			int check_k = drusilla->kfn(&query[i*d], list);
-
-			float ratio = 0.0f;
-			for (int j = 0; j < top_k; ++j) {
-				if (fabs(list->ith_key(j) - R[i*MAXK+j].key_) < CHECK_ERROR) 
-					ratio += 1.0f;
-				else 
-					ratio += R[i*MAXK+j].key_ / list->ith_key(j);
-			}
-			g_ratio    += ratio / top_k;
-			g_recall   += calc_recall(top_k, &R[i*MAXK], list);
-			g_fraction += check_k * 100.0f / n;
-		}
-		delete list; list = NULL;
-		gettimeofday(&g_end_time, NULL);
-		g_runtime = g_end_time.tv_sec - g_start_time.tv_sec + 
-			(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
-
-		g_ratio    = g_ratio    / qn;
-		g_recall   = g_recall   / qn;
-		g_fraction = g_fraction / qn;
-		g_runtime  = (g_runtime * 1000.0f) / qn;
-
-		printf("%3d\t\t%.4f\t\t%.4f\t\t%.2f%%\t\t%.2f%%\n", top_k, g_ratio, 
-			g_runtime, g_recall, g_fraction);
-		fprintf(fp, "%d\t%f\t%f\t%f\t%f\n", top_k, g_ratio, g_runtime, 
-			g_recall, g_fraction);
-	}
-	printf("\n");
-	fprintf(fp, "\n");
+	int ret = kfn_search(n, qn, d, "drusilla_select", query, R, out_path, fp, 
+		[&](int /*k*/, const float *q, MaxK_List *list) {
+			return drusilla->kfn(q, list); });
 	fclose(fp);
 	delete drusilla;
 	
-	return 0;
+	return ret;
 }
 
 // -----------------------------------------------------------------------------
@@ -247,7 +377,8 @@ int rqalsh(							// c-k-AFN search of RQALSH
 	int   qn,							// number of query objects
 	int   d,							// dimensionality
 	float ratio,						// approximation ratio
-	const float *data,					// data set
+	const char *data_set,				// address of data set
+	float *data,						// data set (read here if g_stream)
 	const float *query,					// query set
 	const Result *R, 					// truth set
 	const char *out_path)				// output path
@@ -259,14 +390,26 @@ int rqalsh(							// c-k-AFN search of RQALSH
 	// -------------------------------------------------------------------------
 	//  indexing
 	// -------------------------------------------------------------------------
+	begin_mem_phase(MEM_BUILD);
+	TRACE_BEGIN("build", n);
 	gettimeofday(&g_start_time, NULL);
-	RQALSH* lsh = new RQALSH(n, d, ratio, NULL, data);
+	RQALSH* lsh = NULL;
+	if (g_stream) {
+		lsh = new RQALSH(n, d, ratio, data_set, data, MAGIC, g_proj, 
+			g_n_threshold);
+	}
+	else {
+		lsh = new RQALSH(n, d, ratio, NULL, data, false, MAGIC, g_proj, NULL, 
+			NULL, g_n_threshold);
+	}
 	lsh->display();
 	
 	gettimeofday(&g_end_time, NULL);
 	g_indextime = g_end_time.tv_sec - g_start_time.tv_sec + 
 		(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
 	g_memory = lsh->get_memory_usage() / 1048576.0f;
+	TRACE_END();
+	end_mem_phase(MEM_BUILD);
 
 	printf("Indexing Time = %f Seconds\n", g_indextime);
 	printf("Memory = %f MB\n\n", g_memory);
@@ -279,51 +422,38 @@ int rqalsh(							// c-k-AFN search of RQALSH
 	//  c-k-AFN search
 	// -------------------------------------------------------------------------
 	printf("Top-k FN Search of RQALSH:\n");
-	printf("Top-k\t\tRatio\t\tTime (ms)\tRecall (%)\tFraction (%)\n");
-	for (int num = 0; num < MAX_ROUND; ++num) {
-		gettimeofday(&g_start_time, NULL);
-		int top_k = TOPK[num];
-		MaxK_List *list = new MaxK_List(top_k);
-
-		g_ratio    = 0.0f;
-		g_recall   = 0.0f;
-		g_fraction = 0.0f;
-		for (int i = 0; i < qn; ++i) {
-			list->reset();
-			int check_k = lsh->kfn(top_k, MINREAL, &query[i*d], list);
-
-			float ratio = 0.0f;
-			for (int j = 0; j < top_k; ++j) {
-				if (fabs(list->ith_key(j) - R[i*MAXK+j].key_) < CHECK_ERROR) 
-					ratio += 1.0f;
-				else 
-					ratio += R[i*MAXK+j].key_ / list->ith_key(j);
-			}
-			g_ratio    += ratio / top_k;
-			g_recall   += calc_recall(top_k, &R[i*MAXK], list);
-			g_fraction += check_k * 100.0f / n;
-		}
-		delete list; list = NULL;
-		gettimeofday(&g_end_time, NULL);
-		g_runtime = g_end_time.tv_sec - g_start_time.tv_sec + 
-			(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
-
-		g_ratio    = g_ratio    / qn;
-		g_recall   = g_recall   / qn;
-		g_fraction = g_fraction / qn;
-		g_runtime  = (g_runtime * 1000.0f) / qn;
-
-		printf("%3d\t\t%.4f\t\t%.4f\t\t%.2f%%\t\t%.2f%%\n", top_k, g_ratio, 
-			g_runtime, g_recall, g_fraction);
-		fprintf(fp, "%d\t%f\t%f\t%f\t%f\n", top_k, g_ratio, g_runtime, 
-			g_recall, g_fraction);
+	int ret = 0;
+	if (g_budget > 0 || g_deadline > 0.0f) {
+		int cut = 0;
+		ret = kfn_search(n, qn, d, "rqalsh", query, R, out_path, fp, 
+			[&](int k, const float *q, MaxK_List *list) {
+				bool finished = true;
+				int check = lsh->kfn(k, MINREAL, g_budget, get_deadline(), q, 
+					list, finished);
+				if (!finished) ++cut;
+				return check; });
+		report_anytime(qn, cut, fp);
 	}
-	printf("\n");
-	fprintf(fp, "\n");
+	else if (g_group > 1) {
+		ret = kfn_search_group(n, qn, d, "rqalsh", query, R, out_path, fp, 
+			[&](int k, int num, const float **q, MaxK_List **list, int *check) {
+				float *range = new float[num];
+				for (int i = 0; i < num; ++i) range[i] = MINREAL;
+				lsh->kfn_group(k, num, range, q, list, check);
+				delete[] range; });
+	}
+	else {
+		ret = kfn_search(n, qn, d, "rqalsh", query, R, out_path, fp, 
+			[&](int k, const float *q, MaxK_List *list) {
+				return lsh->kfn(k, MINREAL, q, list); });
+	}
+#ifdef RQALSH_STATS
+	if (ret == 0) ret = output_stats("rqalsh", out_path, lsh);
+#endif
 	fclose(fp);
 	delete lsh;
 
-	return 0;
+	return ret;
 }
 
 // -----------------------------------------------------------------------------
@@ -334,6 +464,8 @@ int rqalsh_star(					// c-k-AFN search of RQALSH*
 	int   L,							// number of projection (drusilla)
 	int   M,							// number of candidates (drusilla)
 	float ratio,						// approximation ratio
+	bool  fold,							// fold centering into the math?
+	bool  packed,						// pack candidates contiguously?
 	const float *data,					// data set
 	const float *query,					// query set
 	const Result *R, 					// truth set
@@ -347,14 +479,19 @@ int rqalsh_star(					// c-k-AFN search of RQALSH*
 	// -------------------------------------------------------------------------
 	//  indexing
 	// -------------------------------------------------------------------------
+	begin_mem_phase(MEM_BUILD);
+	TRACE_BEGIN("build", n);
 	gettimeofday(&g_start_time, NULL);
-	RQALSH_STAR* lsh = new RQALSH_STAR(n, d, L, M, ratio, data);
+	RQALSH_STAR* lsh = new RQALSH_STAR(n, d, L, M, ratio, fold, packed, 
+		data, g_proj, g_n_threshold);
 	lsh->display();
 	
 	gettimeofday(&g_end_time, NULL);
 	g_indextime = g_end_time.tv_sec - g_start_time.tv_sec + 
 		(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
 	g_memory = lsh->get_memory_usage() / 1048576.0f;
+	TRACE_END();
+	end_mem_phase(MEM_BUILD);
 
 	printf("Indexing Time = %f Seconds\n", g_indextime);
 	printf("Memory = %f MB\n\n", g_memory);
@@ -367,51 +504,36 @@ int rqalsh_star(					// c-k-AFN search of RQALSH*
 	//  c-k-AFN search
 	// -------------------------------------------------------------------------
 	printf("Top-k FN Search of RQALSH*:\n");
-	printf("Top-k\t\tRatio\t\tTime (ms)\tRecall (%)\tFraction (%)\n");
-	for (int num = 0; num < MAX_ROUND; ++num) {
-		gettimeofday(&g_start_time, NULL);
-		int top_k = TOPK[num];
-		MaxK_List *list = new MaxK_List(top_k);
-
-		g_ratio    = 0.0f;
-		g_recall   = 0.0f;
-		g_fraction = 0.0f;
-		for (int i = 0; i < qn; ++i) {
-			list->reset();
-			int check_k = lsh->kfn(top_k, &query[i*d], list);
-
-			float ratio = 0.0f;
-			for (int j = 0; j < top_k; ++j) {
-				if (fabs(list->ith_key(j) - R[i*MAXK+j].key_) < CHECK_ERROR) 
-					ratio += 1.0f;
-				else 
-					ratio += R[i*MAXK+j].key_ / list->ith_key(j);
-			}
-			g_ratio    += ratio / top_k;
-			g_recall   += calc_recall(top_k, &R[i*MAXK], list);
-			g_fraction += check_k * 100.0f / n;
-		}
-		delete list; list = NULL;
-		gettimeofday(&g_end_time, NULL);
-		g_runtime = g_end_time.tv_sec - g_start_time.tv_sec + 
-			(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
-
-		g_ratio    = g_ratio    / qn;
-		g_recall   = g_recall   / qn;
-		g_fraction = g_fraction / qn;
-		g_runtime  = (g_runtime * 1000.0f) / qn;
-
-		printf("%3d\t\t%.4f\t\t%.4f\t\t%.2f%%\t\t%.2f%%\n", top_k, g_ratio, 
-			g_runtime, g_recall, g_fraction);
-		fprintf(fp, "%d\t%f\t%f\t%f\t%f\n", top_k, g_ratio, g_runtime, 
-			g_recall, g_fraction);
+	int ret = 0;
+	if (g_budget > 0 || g_deadline > 0.0f) {
+		int cut = 0;
+		ret = kfn_search(n, qn, d, "rqalsh_star", query, R, out_path, fp, 
+			[&](int k, const float *q, MaxK_List *list) {
+				bool finished = true;
+				int check = lsh->kfn(k, g_budget, get_deadline(), q, list, 
+					finished);
+				if (!finished) ++cut;
+				return check; });
+		report_anytime(qn, cut, fp);
 	}
-	printf("\n");
-	fprintf(fp, "\n");
+	else if (g_group > 1) {
+		ret = kfn_search_group(n, qn, d, "rqalsh_star", query, R, out_path, 
+			fp, 
+			[&](int k, int num, const float **q, MaxK_List **list, int *check) {
+				lsh->kfn_group(k, num, q, list, check); });
+	}
+	else {
+		ret = kfn_search(n, qn, d, "rqalsh_star", query, R, out_path, fp, 
+			[&](int k, const float *q, MaxK_List *list) {
+				return lsh->kfn(k, q, list); });
+	}
+#ifdef RQALSH_STATS
+	if (ret == 0) ret = output_stats("rqalsh_star", out_path, lsh);
+#endif
 	fclose(fp);
 	delete lsh;
 
-	return 0;
+	return ret;
 }
 
 // -----------------------------------------------------------------------------
@@ -420,6 +542,8 @@ int ml_rqalsh(						// c-k-AFN search of ML-RQALSH
 	int   qn,							// number of query objects
 	int   d,							// dimensionality
 	float ratio,						// approximation ratio
+	int   max_blocks,					// max #blocks kept (0: build all)
+	bool  adaptive,						// partition by cost model?
 	const float *data,					// data set
 	const float *query,					// query set
 	const Result *R, 					// truth set
@@ -432,19 +556,25 @@ int ml_rqalsh(						// c-k-AFN search of ML-RQALSH
 	// -------------------------------------------------------------------------
 	//  indexing
 	// -------------------------------------------------------------------------
+	begin_mem_phase(MEM_BUILD);
+	TRACE_BEGIN("build", n);
 	gettimeofday(&g_start_time, NULL);
-	ML_RQALSH* lsh = new ML_RQALSH(n, d, ratio, data);
+	ML_RQALSH* lsh = new ML_RQALSH(n, d, ratio, max_blocks, adaptive, 
+		data, g_proj, g_n_threshold, g_hugepage);
 	lsh->display();
 
 	gettimeofday(&g_end_time, NULL);
 	g_indextime = g_end_time.tv_sec - g_start_time.tv_sec + 
 		(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
 	g_memory = lsh->get_memory_usage() / 1048576.0f;
+	TRACE_END();
+	end_mem_phase(MEM_BUILD);
 
 	printf("Indexing Time = %f Seconds\n", g_indextime);
 	printf("Memory = %f MB\n\n", g_memory);
 	
 	fprintf(fp, "ML_RQALSH:\n");
+	fprintf(fp, "Partition: %s\n", adaptive ? "cost model" : "LAMBDA");
 	fprintf(fp, "Indexing Time: %f Seconds\n", g_indextime);
 	fprintf(fp, "Estimated Memory: %f MB\n", g_memory);
 
@@ -452,49 +582,45 @@ int ml_rqalsh(						// c-k-AFN search of ML-RQALSH
 	//  c-k-AFN search
 	// -------------------------------------------------------------------------
 	printf("Top-k FN Search of ML_RQALSH:\n");
-	printf("Top-k\t\tRatio\t\tTime (ms)\tRecall (%)\tFraction (%)\n");
-	for (int num = 0; num < MAX_ROUND; ++num) {
-		gettimeofday(&g_start_time, NULL);
-		int top_k = TOPK[num];
-		MaxK_List *list = new MaxK_List(top_k);
-
-		g_ratio    = 0.0f;
-		g_recall   = 0.0f;
-		g_fraction = 0.0f;
-		for (int i = 0; i < qn; ++i) {
-			list->reset();
-			int check_k = lsh->kfn(top_k, &query[i*d], list);
-
-			float ratio = 0.0f;
-			for (int j = 0; j < top_k; ++j) {
-				if (fabs(list->ith_key(j) - R[i*MAXK+j].key_) < CHECK_ERROR) 
-					ratio += 1.0f;
-				else 
-					ratio += R[i*MAXK+j].key_ / list->ith_key(j);
-			}
-			g_ratio    += ratio / top_k;
-			g_recall   += calc_recall(top_k, &R[i*MAXK], list);
-			g_fraction += check_k * 100.0f / n;
-		}
-		delete list; list = NULL;
-		gettimeofday(&g_end_time, NULL);
-		g_runtime = g_end_time.tv_sec - g_start_time.tv_sec + 
-			(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
-
-		g_ratio    = g_ratio    / qn;
-		g_recall   = g_recall   / qn;
-		g_fraction = g_fraction / qn;
-		g_runtime  = (g_runtime * 1000.0f) / qn;
-
-		printf("%3d\t\t%.4f\t\t%.4f\t\t%.2f%%\t\t%.2f%%\n", top_k, g_ratio, 
-			g_runtime, g_recall, g_fraction);
-		fprintf(fp, "%d\t%f\t%f\t%f\t%f\n", top_k, g_ratio, g_runtime, 
-			g_recall, g_fraction);
+	int ret = 0;
+	if (g_budget > 0 || g_deadline > 0.0f) {
+		int cut = 0;
+		ret = kfn_search(n, qn, d, "ml_rqalsh", query, R, out_path, fp, 
+			[&](int k, const float *q, MaxK_List *list) {
+				bool finished = true;
+				int check = lsh->kfn(k, g_budget, get_deadline(), q, list, 
+					finished);
+				if (!finished) ++cut;
+				return check; });
+		report_anytime(qn, cut, fp);
 	}
-	printf("\n");
-	fprintf(fp, "\n");
-	fclose(fp);
+	else if (g_group > 1) {
+		ret = kfn_search_group(n, qn, d, "ml_rqalsh", query, R, out_path, fp, 
+			[&](int k, int num, const float **q, MaxK_List **list, int *check) {
+				lsh->kfn_group(k, num, q, list, check); });
+	}
+	else {
+		ret = kfn_search(n, qn, d, "ml_rqalsh", query, R, out_path, fp, 
+			[&](int k, const float *q, MaxK_List *list) {
+				return lsh->kfn(k, q, list); });
+	}
+	if (max_blocks > 0) {
+		// blocks built on demand are not counted in the indexing time
+		g_memory = lsh->get_memory_usage() / 1048576.0f;
+		printf("Block Builds = %d\n", lsh->get_num_builds());
+		printf("Memory after Search = %f MB\n\n", g_memory);
+		fprintf(fp, "Block Builds: %d\n", lsh->get_num_builds());
+		fprintf(fp, "Memory after Search: %f MB\n\n", g_memory);
+	}
+#ifdef RQALSH_STATS
+	if (ret == 0) ret = output_stats("ml_rqalsh", out_path, lsh);
+#endif
+	double start = get_cur_time();
 	delete lsh; 
+	double teardown = (get_cur_time() - start) / 1000.0;
+	printf("Teardown Time = %f Seconds\n\n", teardown);
+	fprintf(fp, "Teardown Time: %f Seconds\n\n", teardown);
+	fclose(fp);
 
-	return 0;
+	return ret;
 }
\ No newline at end of file
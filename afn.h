@@ -35,7 +35,8 @@ int qdafn(							// c-k-AFN search of QDAFN
 	int   L,							// number of projections
 	int   M,							// number of candidates
 	float ratio,						// approximation ratio
-	const float *data,					// data set
+	const char *data_set,				// address of data set
+	float *data,						// data set (read here if g_stream)
 	const float *query,					// query set
 	const Result *R, 					// truth set
 	const char *out_path);				// output path
@@ -47,6 +48,8 @@ int drusilla_select(				// c-k-AFN search of Drusilla-Select
 	int   d,							// number of dimensions
 	int   L,							// number of projections
 	int   M,							// number of candidates
+	bool  fold,							// fold centering into the math?
+	bool  packed,						// pack candidates contiguously?
 	const float *data,					// data set
 	const float *query,					// query set
 	const Result *R, 					// truth set
@@ -58,7 +61,8 @@ int rqalsh(							// c-k-AFN search of RQALSH
 	int   qn,							// number of query objects
 	int   d,							// dimensionality
 	float ratio,						// approximation ratio
-	const float *data,					// data set
+	const char *data_set,				// address of data set
+	float *data,						// data set (read here if g_stream)
 	const float *query,					// query set
 	const Result *R, 					// truth set
 	const char *out_path);				// output path
@@ -71,6 +75,8 @@ int rqalsh_star(					// c-k-AFN search of RQALSH*
 	int   L,							// number of projection (drusilla)
 	int   M,							// number of candidates (drusilla)
 	float ratio,						// approximation ratio
+	bool  fold,							// fold centering into the math?
+	bool  packed,						// pack candidates contiguously?
 	const float *data,					// data set
 	const float *query,					// query set
 	const Result *R, 					// truth set
@@ -82,6 +88,8 @@ int ml_rqalsh(						// c-k-AFN search of ML-RQALSH
 	int   qn,							// number of query objects
 	int   d,							// dimensionality
 	float ratio,						// approximation ratio
+	int   max_blocks,					// max #blocks kept (0: build all)
+	bool  adaptive,						// partition by cost model?
 	const float *data,					// data set
 	const float *query,					// query set
 	const Result *R, 					// truth set
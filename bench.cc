@@ -0,0 +1,405 @@
+#include "bench.h"
+
+// -----------------------------------------------------------------------------
+//  Linear_Merge: the candidates are picked by scanning all L heads
+// -----------------------------------------------------------------------------
+static int linear_merge(			// pick candidates by linear scan
+	int   n,							// number of entries in each projection
+	int   L,							// number of projections
+	int   candidates,					// number of candidates
+	const float *pdist,					// sorted projected values (L * n)
+	const float *proj_q,				// projected values of query
+	int   *next)						// next position of each proj (return)
+{
+	int check = 0;
+	for (int i = 0; i < L; ++i) next[i] = 0;
+
+	for (int i = 0; i < candidates; ++i) {
+		float y = -1.0f;
+		int   found_in_proj = -1;
+
+		for (int j = 0; j < L; ++j) {
+			if (next[j] >= n) continue;
+			float z = fabs(pdist[j*n+next[j]] - proj_q[j]);
+			if (z > y) { y = z; found_in_proj = j; }
+		}
+		if (found_in_proj < 0) break;
+		next[found_in_proj]++;
+		check += found_in_proj;
+	}
+	return check;
+}
+
+// -----------------------------------------------------------------------------
+//  Heap_Merge: the candidates are picked by a max-heap over L heads
+// -----------------------------------------------------------------------------
+static int heap_merge(				// pick candidates by max-heap
+	int   n,							// number of entries in each projection
+	int   L,							// number of projections
+	int   candidates,					// number of candidates
+	const float *pdist,					// sorted projected values (L * n)
+	const float *proj_q,				// projected values of query
+	int   *next,						// next position of each proj (return)
+	Head_Heap *heap)					// max-heap over L heads
+{
+	int check = 0;
+	heap->reset();
+	for (int i = 0; i < L; ++i) {
+		next[i] = 0;
+		heap->push(fabs(pdist[i*n] - proj_q[i]), i);
+	}
+
+	for (int i = 0; i < candidates && !heap->empty(); ++i) {
+		int j = heap->top_id();
+		if (++next[j] < n) {
+			heap->replace_top(fabs(pdist[j*n+next[j]] - proj_q[j]), j);
+		}
+		else heap->pop();
+		check += j;
+	}
+	return check;
+}
+
+// -----------------------------------------------------------------------------
+int merge_bench(					// benchmark of candidate merge in QDAFN
+	int   n,							// number of entries in each projection
+	int   qn,							// number of queries
+	float ratio,						// approximation ratio
+	const char *out_path)				// output path
+{
+	char output_set[200]; sprintf(output_set, "%smerge_bench.out", out_path);
+	FILE *fp = fopen(output_set, "a+");
+	if (!fp) { printf("Could not create %s\n", output_set); return 1; }
+
+	const int L_LIST[] = { 8, 32, 128, 512, 2048 };
+	const int L_NUM = 5;
+
+	// the number of candidates follows the setting of QDAFN
+	float x = pow(log((float) n), (ratio*ratio/2.0F - 1.0F/3.0F));
+
+	fprintf(fp, "Merge Bench: n=%d, qn=%d, c=%.1f\n", n, qn, ratio);
+	printf("Candidate Merge of QDAFN: n = %d, qn = %d, c = %.1f\n", n, qn, ratio);
+	printf("L\t\tCandidates\tLinear (ms)\tHeap (ms)\tSpeedup\n");
+	for (int num = 0; num < L_NUM; ++num) {
+		int L = L_LIST[num];
+		int candidates = 1 + (int) ceil(E * E * L * x) + MAXK;
+		if (candidates > n) candidates = n;
+
+		// generate L sorted projections and the projected values of queries
+		float *pdist  = new float[(int64_t) L * n];
+		float *proj_q = new float[L * qn];
+		int   *next   = new int[L];
+		Head_Heap *heap = new Head_Heap(L);
+
+		Random_Gen rng(MAGIC + L);
+		rng.gaussian(L * n, 0.0f, 1.0f, pdist);
+		rng.gaussian(L * qn, 0.0f, 1.0f, proj_q);
+		for (int i = 0; i < L; ++i) std::sort(pdist + i*n, pdist + (i+1)*n);
+
+		// linear scan over L heads
+		int check1 = 0;
+		gettimeofday(&g_start_time, NULL);
+		for (int i = 0; i < qn; ++i) {
+			check1 += linear_merge(n, L, candidates, pdist, &proj_q[i*L], next);
+		}
+		gettimeofday(&g_end_time, NULL);
+		float linear_time = g_end_time.tv_sec - g_start_time.tv_sec + 
+			(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
+		linear_time = linear_time * 1000.0f / qn;
+
+		// max-heap over L heads
+		int check2 = 0;
+		gettimeofday(&g_start_time, NULL);
+		for (int i = 0; i < qn; ++i) {
+			check2 += heap_merge(n, L, candidates, pdist, &proj_q[i*L], next, 
+				heap);
+		}
+		gettimeofday(&g_end_time, NULL);
+		float heap_time = g_end_time.tv_sec - g_start_time.tv_sec + 
+			(g_end_time.tv_usec - g_start_time.tv_usec) / 1000000.0f;
+		heap_time = heap_time * 1000.0f / qn;
+
+		if (check1 != check2) printf("Merge results are different!\n");
+		printf("%d\t\t%d\t\t%.4f\t\t%.4f\t\t%.2f\n", L, candidates, 
+			linear_time, heap_time, linear_time / heap_time);
+		fprintf(fp, "%d\t%d\t%f\t%f\n", L, candidates, linear_time, heap_time);
+
+		delete[] pdist;
+		delete[] proj_q;
+		delete[] next;
+		delete heap;
+	}
+	printf("\n");
+	fprintf(fp, "\n");
+	fclose(fp);
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+static double run_single(			// run c-k-AFN search one query at a time
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	const float *query,					// query set
+	RQALSH *lsh,						// index
+	MaxK_List **list)					// c-k-AFN results (return)
+{
+	double start = get_cur_time();
+	for (int i = 0; i < qn; ++i) {
+		list[i]->reset();
+		lsh->kfn(MAXK, MINREAL, &query[i*d], list[i]);
+	}
+	return get_cur_time() - start;
+}
+
+// -----------------------------------------------------------------------------
+static double run_group(			// run c-k-AFN search by groups of queries
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	int   group,						// number of interleaved queries
+	const float *query,					// query set
+	RQALSH *lsh,						// index
+	MaxK_List **list)					// c-k-AFN results (return)
+{
+	float *R = new float[group];
+	int   *check = new int[group];
+	const float **q = new const float*[group];
+	for (int i = 0; i < group; ++i) R[i] = MINREAL;
+
+	double start = get_cur_time();
+	for (int i = 0; i < qn; i += group) {
+		int num = MIN(group, qn - i);
+		for (int j = 0; j < num; ++j) {
+			list[i+j]->reset();
+			q[j] = &query[(i+j)*d];
+		}
+		lsh->kfn_group(MAXK, num, R, q, &list[i], check);
+	}
+	double runtime = get_cur_time() - start;
+
+	delete[] R;
+	delete[] check;
+	delete[] q;
+	return runtime;
+}
+
+// -----------------------------------------------------------------------------
+static bool same_results(			// are the c-k-AFN results the same?
+	int   qn,							// number of query objects
+	MaxK_List **list1,					// 1st results
+	MaxK_List **list2)					// 2nd results
+{
+	for (int i = 0; i < qn; ++i) {
+		if (list1[i]->size() != list2[i]->size()) return false;
+		for (int j = 0; j < list1[i]->size(); ++j) {
+			if (list1[i]->ith_id(j) != list2[i]->ith_id(j)) return false;
+		}
+	}
+	return true;
+}
+
+// -----------------------------------------------------------------------------
+int scan_bench(						// benchmark of RQALSH table scan
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	float ratio,						// approximation ratio
+	const float *data,					// data set
+	const float *query,					// query set
+	const char *out_path)				// output path
+{
+	char output_set[200]; sprintf(output_set, "%sscan_bench.out", out_path);
+	FILE *fp = fopen(output_set, "a+");
+	if (!fp) { printf("Could not create %s\n", output_set); return 1; }
+
+	const int D_LIST[] = { 0, 4, 8, 16, 32 };
+	const int D_NUM  = 5;
+	const int G_LIST[] = { 2, 4, 8, 16, 32 };
+	const int G_NUM  = 5;
+	const int REPEAT = 3;			// the best of REPEAT runs is reported
+
+	RQALSH *lsh = new RQALSH(n, d, ratio, NULL, data, false, MAGIC, g_proj, 
+		NULL, NULL, g_n_threshold);
+	lsh->display();
+
+	MaxK_List **truth = new MaxK_List*[qn];
+	MaxK_List **list  = new MaxK_List*[qn];
+	for (int i = 0; i < qn; ++i) {
+		truth[i] = new MaxK_List(MAXK);
+		list[i]  = new MaxK_List(MAXK);
+	}
+	fprintf(fp, "Scan Bench: n=%d, qn=%d, d=%d, c=%.1f\n", n, qn, d, ratio);
+
+	// -------------------------------------------------------------------------
+	//  prefetch distance of kfn (0: no prefetch)
+	// -------------------------------------------------------------------------
+	printf("Prefetch of RQALSH: n = %d, qn = %d, d = %d, c = %.1f\n", n, qn, 
+		d, ratio);
+	printf("Distance\tTime (ms)\tSpeedup\n");
+	double base = -1.0, runtime = -1.0;
+	for (int num = 0; num < D_NUM; ++num) {
+		int dist = D_LIST[num];
+		lsh->set_prefetch(dist);
+
+		runtime = MAXREAL;
+		for (int r = 0; r < REPEAT; ++r) {
+			runtime = MIN(runtime, run_single(qn, d, query, lsh, 
+				dist == 0 ? truth : list));
+		}
+		if (dist == 0) base = runtime;
+		else if (!same_results(qn, truth, list)) {
+			printf("Search results are different!\n");
+		}
+		printf("%d\t\t%.4f\t\t%.2f\n", dist, runtime / qn, base / runtime);
+		fprintf(fp, "D=%d\t%f\n", dist, runtime / qn);
+	}
+	printf("\n");
+
+	// -------------------------------------------------------------------------
+	//  interleaved search of a group of queries (group 1: kfn)
+	// -------------------------------------------------------------------------
+	lsh->set_prefetch(PREFETCH_DIST);
+	base = MAXREAL;
+	for (int r = 0; r < REPEAT; ++r) {
+		base = MIN(base, run_single(qn, d, query, lsh, list));
+	}
+	printf("Interleaved Search of RQALSH: n = %d, qn = %d, d = %d, c = %.1f\n", 
+		n, qn, d, ratio);
+	printf("Group\t\tTime (ms)\tSpeedup\n");
+	printf("1\t\t%.4f\t\t%.2f\n", base / qn, 1.0f);
+	fprintf(fp, "G=1\t%f\n", base / qn);
+
+	for (int num = 0; num < G_NUM; ++num) {
+		int group = G_LIST[num];
+		runtime = MAXREAL;
+		for (int r = 0; r < REPEAT; ++r) {
+			runtime = MIN(runtime, run_group(qn, d, group, query, lsh, list));
+		}
+		// the interleaved search must return the same results
+		if (!same_results(qn, truth, list)) {
+			printf("Search results are different!\n");
+		}
+		printf("%d\t\t%.4f\t\t%.2f\n", group, runtime / qn, base / runtime);
+		fprintf(fp, "G=%d\t%f\n", group, runtime / qn);
+	}
+	printf("\n");
+	fprintf(fp, "\n");
+	fclose(fp);
+
+	for (int i = 0; i < qn; ++i) { delete truth[i]; delete list[i]; }
+	delete[] truth;
+	delete[] list;
+	delete lsh;
+
+	return 0;
+}
+
+// -----------------------------------------------------------------------------
+static double time_kernel(			// time a distance kernel over a data set
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	Dist_Func func,						// kernel
+	const float *data,					// data set
+	const float *query,					// query set
+	float *dist)						// results of the last query (return)
+{
+	double start = get_cur_time();
+	for (int i = 0; i < qn; ++i) {
+		const float *q = &query[i*d];
+		for (int j = 0; j < n; ++j) dist[j] = func(d, q, &data[(int64_t) j*d]);
+	}
+	return get_cur_time() - start;
+}
+
+// -----------------------------------------------------------------------------
+static double time_batch(			// time a batch kernel over a data set
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	Batch_Func func,					// kernel
+	const float *data,					// data set
+	const float *query,					// query set
+	float *dist)						// results of the last query (return)
+{
+	double start = get_cur_time();
+	for (int i = 0; i < qn; ++i) func(n, d, &query[i*d], data, dist);
+	return get_cur_time() - start;
+}
+
+// -----------------------------------------------------------------------------
+int kernel_bench(					// benchmark of dimension-specialized kernels
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	const char *out_path)				// output path
+{
+	char output_set[200]; sprintf(output_set, "%skernel_bench.out", out_path);
+	FILE *fp = fopen(output_set, "a+");
+	if (!fp) { printf("Could not create %s\n", output_set); return 1; }
+
+#define KERNEL_DIM(D) D,
+	const int D_LIST[] = { KERNEL_DIMS(KERNEL_DIM) };
+#undef KERNEL_DIM
+	const int D_NUM  = sizeof(D_LIST) / sizeof(D_LIST[0]);
+	const int REPEAT = 3;			// the best of REPEAT runs is reported
+	const char *K_NAME[] = { "L2", "IP", "Batch" };
+
+	fprintf(fp, "Kernel Bench: n=%d, qn=%d\n", n, qn);
+	printf("Dimension-Specialized Kernels: n = %d, qn = %d\n", n, qn);
+	printf("Dim\t\tKernel\t\tGeneric (ms)\tFixed (ms)\tSpeedup\t\tMax Error\n");
+	for (int num = 0; num < D_NUM; ++num) {
+		int d = D_LIST[num];
+		float *data  = new float[(int64_t) n * d];
+		float *query = new float[qn * d];
+		float *dist1 = new float[n];
+		float *dist2 = new float[n];
+
+		Random_Gen rng(MAGIC + d);
+		rng.gaussian(n * d, 0.0f, 1.0f, data);
+		rng.gaussian(qn * d, 0.0f, 1.0f, query);
+
+		for (int k = 0; k < 3; ++k) {
+			double generic = MAXREAL, fixed = MAXREAL;
+			for (int r = 0; r < REPEAT; ++r) {
+				if (k == 0) {
+					generic = MIN(generic, time_kernel(n, qn, d, calc_l2_dist, 
+						data, query, dist1));
+					fixed = MIN(fixed, time_kernel(n, qn, d, 
+						get_l2_dist_func(d), data, query, dist2));
+				}
+				else if (k == 1) {
+					generic = MIN(generic, time_kernel(n, qn, d, 
+						calc_inner_product, data, query, dist1));
+					fixed = MIN(fixed, time_kernel(n, qn, d, 
+						get_inner_product_func(d), data, query, dist2));
+				}
+				else {
+					generic = MIN(generic, time_batch(n, qn, d, 
+						calc_l2_dist_batch, data, query, dist1));
+					fixed = MIN(fixed, time_batch(n, qn, d, 
+						get_l2_dist_batch_func(d), data, query, dist2));
+				}
+			}
+			// the specialized kernels only differ in the order of summation
+			float error = 0.0f;
+			for (int j = 0; j < n; ++j) {
+				float diff = fabs(dist1[j] - dist2[j]);
+				if (fabs(dist1[j]) > CHECK_ERROR) diff /= fabs(dist1[j]);
+				error = MAX(error, diff);
+			}
+			printf("%d\t\t%s\t\t%.4f\t\t%.4f\t\t%.2f\t\t%.1e\n", d, 
+				K_NAME[k], generic / qn, fixed / qn, generic / fixed, error);
+			fprintf(fp, "%d\t%s\t%f\t%f\t%e\n", d, K_NAME[k], generic / qn, 
+				fixed / qn, error);
+		}
+		delete[] data;
+		delete[] query;
+		delete[] dist1;
+		delete[] dist2;
+	}
+	printf("\n");
+	fprintf(fp, "\n");
+	fclose(fp);
+
+	return 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <sys/time.h>
+
+#include "def.h"
+#include "util.h"
+#include "random.h"
+#include "pri_queue.h"
+#include "rqalsh.h"
+
+// -----------------------------------------------------------------------------
+//  micro-benchmarks for the building blocks of the indexes
+// -----------------------------------------------------------------------------
+int merge_bench(					// benchmark of candidate merge in QDAFN
+	int   n,							// number of entries in each projection
+	int   qn,							// number of queries
+	float ratio,						// approximation ratio
+	const char *out_path);				// output path
+
+// -----------------------------------------------------------------------------
+int scan_bench(						// benchmark of RQALSH table scan
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	float ratio,						// approximation ratio
+	const float *data,					// data set
+	const float *query,					// query set
+	const char *out_path);				// output path
+
+// -----------------------------------------------------------------------------
+int kernel_bench(					// benchmark of dimension-specialized kernels
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	const char *out_path);				// output path
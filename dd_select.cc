@@ -0,0 +1,246 @@
+#include "dd_select.h"
+
+// -----------------------------------------------------------------------------
+static bool ResultLessDesc(			// compare func for std::partial_sort
+	const Result &a,					// 1st element
+	const Result &b)					// 2nd element
+{
+	return ResultCompDesc((const void*) &a, (const void*) &b) < 0;
+}
+
+// -----------------------------------------------------------------------------
+template<int D>
+static void calc_offset(			// calc offset and distortion of an object
+	int   dim,							// dimension (used if D = 0)
+	bool  fold,							// fold centering into the math?
+	float norm,							// l2-norm of the shifted object
+	float c_p,							// <centroid, proj> (used if fold)
+	const float *x,						// object (shifted unless fold)
+	const float *proj,					// projection vector
+	float &offset,						// offset (return)
+	float &distortion)					// squared distortion (return)
+{
+	const int d = D > 0 ? D : dim;
+	offset = 0.0f;
+	#pragma omp simd reduction(+:offset)
+	for (int k = 0; k < d; ++k) offset += x[k] * proj[k];
+
+	distortion = 0.0f;
+	if (fold) {
+		offset -= c_p;
+		distortion = MAX(0.0f, SQR(norm) - SQR(offset));
+	}
+	else {
+		float o = offset;
+		float r = 0.0f;
+		#pragma omp simd reduction(+:r)
+		for (int k = 0; k < d; ++k) r += SQR(x[k] - o * proj[k]);
+		distortion = r;
+	}
+}
+
+typedef void (*Offset_Func)(int, bool, float, float, const float*, 
+	const float*, float&, float&);
+
+// -----------------------------------------------------------------------------
+static Offset_Func get_offset_func(	// get calc_offset() for a dimension
+	int   dim)							// dimension
+{
+	switch (dim) {
+#define KERNEL_CASE(D) case D: return calc_offset<D>;
+	KERNEL_DIMS(KERNEL_CASE)
+#undef KERNEL_CASE
+	default: return calc_offset<0>;
+	}
+}
+
+// -----------------------------------------------------------------------------
+void dd_select(						// data dependent selection
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	int   l,							// number of projections
+	int   m,							// number of candidates on each proj (<= n)
+	int   type,							// type of score (0 or 1)
+	bool  fold,							// fold centering into the math?
+	const float *data,					// data objects
+	int   *cand)						// candidate id (return)
+{
+	// -------------------------------------------------------------------------
+	//  calc the shift data (or only their l2-norms if centering is folded)
+	// -------------------------------------------------------------------------
+	int   max_id      = -1;
+	float max_norm    = -1.0f;
+	float *norm       = new float[n];
+	float *centroid   = new float[d];
+	float *shift_data = NULL;
+
+	calc_centroid(n, d, data, centroid);
+	if (fold) {
+		calc_shift_norm(n, d, data, centroid, max_id, max_norm, norm);
+	}
+	else {
+		shift_data = new float[(int64_t) n * d];
+		calc_shift_data(n, d, data, centroid, max_id, max_norm, norm, shift_data);
+	}
+	const float *base = fold ? data : (const float*) shift_data;
+
+	// -------------------------------------------------------------------------
+	//  data dependent selection
+	// -------------------------------------------------------------------------
+	float  *proj  = new float[d];
+	Result *score = new Result[n];
+	bool   *close_angle = new bool[n];
+	int    top_m = MIN(m, n);
+	Offset_Func offset_func = get_offset_func(d);
+	Dist_Func   inner_prod  = get_inner_product_func(d);
+
+	for (int i = 0; i < l; ++i) {
+		// ---------------------------------------------------------------------
+		//  select the projection vector with largest norm and normalize it
+		// ---------------------------------------------------------------------
+		const float *x_max = &base[(int64_t) max_id * d];
+		for (int j = 0; j < d; ++j) {
+			float x = fold ? x_max[j] - centroid[j] : x_max[j];
+			proj[j] = x / norm[max_id];
+		}
+		float c_p = fold ? inner_prod(d, centroid, proj) : 0.0f;
+
+		// ---------------------------------------------------------------------
+		//  calculate offsets and distortions
+		// ---------------------------------------------------------------------
+		#pragma omp parallel for schedule(static)
+		for (int j = 0; j < n; ++j) {
+			const float *x = &base[(int64_t) j * d];
+			score[j].id_ = j;
+			close_angle[j] = false;
+
+			if ((type == 0 && norm[j] > 0.0f) || (type == 1 && norm[j] >= 0.0f)) {
+				float offset, distortion;
+				offset_func(d, fold, norm[j], c_p, x, proj, offset, distortion);
+
+				if (type == 0) {
+					distortion = sqrt(distortion);
+					score[j].key_ = fabs(offset) - fabs(distortion);
+					if (atan(distortion / fabs(offset)) < ANGLE) {
+						close_angle[j] = true;
+					}
+				}
+				else {
+					score[j].key_ = offset * offset - distortion;
+				}
+			}
+			else if (type == 0 && fabs(norm[j]) < CHECK_ERROR) {
+				score[j].key_ = MINREAL + 1.0f;
+			}
+			else {
+				score[j].key_ = MINREAL;
+			}
+		}
+
+		// ---------------------------------------------------------------------
+		//  collect the objects that are well-represented by this proj: only 
+		//  the top-m objects are sorted
+		// ---------------------------------------------------------------------
+		std::partial_sort(score, score + top_m, score + n, ResultLessDesc);
+		for (int j = 0; j < top_m; ++j) {
+			int id = score[j].id_;
+
+			cand[i*m+j] = id;
+			norm[id] = -1.0f;
+		}
+
+		// ---------------------------------------------------------------------
+		//  find the next largest norm and the corresponding object
+		// ---------------------------------------------------------------------
+		max_id = -1;
+		max_norm = -1.0f;
+		for (int j = 0; j < n; ++j) {
+			if (type == 0 && norm[j] > 0.0f && close_angle[j]) norm[j] = 0.0f;
+			if (norm[j] > max_norm) { max_norm = norm[j]; max_id = j; }
+		}
+	}
+	// -------------------------------------------------------------------------
+	//  release space
+	// -------------------------------------------------------------------------
+	delete[] norm;
+	delete[] centroid;
+	delete[] close_angle;
+	delete[] proj;
+	delete[] score;
+	if (shift_data != NULL) delete[] shift_data;
+}
+
+// -----------------------------------------------------------------------------
+void calc_centroid(					// calculate centroid of data objects
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	const float *data,					// data objects
+	float *centroid)					// centroid (return)
+{
+	memset(centroid, 0, d * SIZEFLOAT);
+	for (int i = 0; i < n; ++i) {
+		for (int j = 0; j < d; ++j) {
+			centroid[j] += data[(int64_t) i*d+j];
+		}
+	}
+	for (int i = 0; i < d; ++i) centroid[i] /= n;
+}
+
+// -----------------------------------------------------------------------------
+void calc_shift_norm(				// calculate l2-norm of shift data objects
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	const float *data,					// data objects
+	const float *centroid,				// centroid of data objects
+	int   &max_id,						// data id with max l2-norm (return)
+	float &max_norm,					// max l2-norm (return)
+	float *norm)						// l2-norm of shift data (return)
+{
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; ++i) {
+		const float *x = &data[(int64_t) i * d];
+
+		float sum = 0.0f;
+		#pragma omp simd reduction(+:sum)
+		for (int j = 0; j < d; ++j) sum += SQR(x[j] - centroid[j]);
+		norm[i] = sqrt(sum);
+	}
+
+	max_id   = -1;
+	max_norm = MINREAL;
+	for (int i = 0; i < n; ++i) {
+		if (norm[i] > max_norm) { max_norm = norm[i]; max_id = i; }
+	}
+}
+
+// -----------------------------------------------------------------------------
+void calc_shift_data(				// calculate shift data objects
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	const float *data,					// data objects
+	const float *centroid,				// centroid of data objects
+	int   &max_id,						// data id with max l2-norm (return)
+	float &max_norm,					// max l2-norm (return)
+	float *norm,						// l2-norm of shift data (return)
+	float *shift_data) 					// shift data (return)
+{
+	#pragma omp parallel for schedule(static)
+	for (int i = 0; i < n; ++i) {
+		const float *x = &data[(int64_t) i * d];
+		float *y = &shift_data[(int64_t) i * d];
+
+		float sum = 0.0f;
+		#pragma omp simd reduction(+:sum)
+		for (int j = 0; j < d; ++j) {
+			y[j] = x[j] - centroid[j];
+			sum += SQR(y[j]);
+		}
+		norm[i] = sqrt(sum);
+	}
+
+	max_id   = -1;
+	max_norm = MINREAL;
+	for (int i = 0; i < n; ++i) {
+		if (norm[i] > max_norm) { max_norm = norm[i]; max_id = i; }
+	}
+}
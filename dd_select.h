@@ -0,0 +1,65 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "def.h"
+#include "util.h"
+#include "pri_queue.h"
+
+// -----------------------------------------------------------------------------
+//  data dependent selection shared by Drusilla_Select and RQALSH*
+//
+//  for l rounds, the shift data object with the largest l2-norm is chosen as 
+//  the projection vector, all data objects are scored by their offsets and 
+//  distortions on it, and the top-m objects are selected as candidates. 
+//
+//  type = 0: score = |offset| - |distortion| (Drusilla_Select), and the data 
+//            objects with close angle are not chosen as projection vectors
+//  type = 1: score = offset^2 - distortion^2 (RQALSH*)
+//
+//  fold = false: the shift data (x - c) are materialized (n * d extra floats)
+//  fold = true:  the centering is folded into the math, where offset = <x,p> 
+//                - <c,p> and distortion^2 = |x-c|^2 - offset^2, so only the 
+//                l2-norms of shift data (n extra floats) are stored
+// -----------------------------------------------------------------------------
+void dd_select(						// data dependent selection
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	int   l,							// number of projections
+	int   m,							// number of candidates on each proj (<= n)
+	int   type,							// type of score (0 or 1)
+	bool  fold,							// fold centering into the math?
+	const float *data,					// data objects
+	int   *cand);						// candidate id (return)
+
+// -----------------------------------------------------------------------------
+void calc_centroid(					// calculate centroid of data objects
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	const float *data,					// data objects
+	float *centroid);					// centroid (return)
+
+// -----------------------------------------------------------------------------
+void calc_shift_norm(				// calculate l2-norm of shift data objects
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	const float *data,					// data objects
+	const float *centroid,				// centroid of data objects
+	int   &max_id,						// data id with max l2-norm (return)
+	float &max_norm,					// max l2-norm (return)
+	float *norm);						// l2-norm of shift data (return)
+
+// -----------------------------------------------------------------------------
+void calc_shift_data(				// calculate shift data objects
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	const float *data,					// data objects
+	const float *centroid,				// centroid of data objects
+	int   &max_id,						// data id with max l2-norm (return)
+	float &max_norm,					// max l2-norm (return)
+	float *norm,						// l2-norm of shift data (return)
+	float *shift_data); 				// shift data (return)
@@ -20,9 +20,42 @@ const int   MAXK          = TOPK[MAX_ROUND - 1];
 const int   CANDIDATES    = 100;
 const int   N_THRESHOLD   = (CANDIDATES + MAXK) * 2;
 const int   SCAN_SIZE     = 64;
+const int   PREFETCH_DIST = 16;
+const int   PREFETCH_N    = 262144;
+const int   PROJ_BLOCK    = 64;
+const int   BATCH_SIZE    = 64;
+const int   STREAM_CHUNK  = 65536;
+const int   ALIGNMENT     = 64;
+const int   CACHE_LINE    = 64;
+const int64_t HUGE_PAGE   = 2097152;
 const int   MAX_BLOCK_NUM = 10000;
 const int   MAGIC         = 36553368;
 const float LAMBDA        = 0.9f;
+const float GRID_RATIO    = 0.99f;
+const float SCAN_FRAC     = 0.25f;
+const float ENTRY_COST    = 3.0f;
+const int   NUM_SAMPLE    = 50;
+
+const int   PROJ_DENSE    = 0;		// dense Gaussian projections
+const int   PROJ_SPARSE   = 1;		// very sparse +-1 projections
+const int   PROJ_HADAMARD = 2;		// Fastfood (Hadamard) projections
+
+const int   GEN_ISOTROPIC   = 0;	// N(0, 1) in every dimension
+const int   GEN_ANISOTROPIC = 1;	// N(0, 1/(j+1)) in dimension j
+const int   GEN_CLUSTERED   = 2;	// mixture of GEN_CLUSTERS Gaussians
+const int   GEN_SHELLS      = 3;	// random directions, Pareto radii
+const int   GEN_BLOCK       = 16384;// objects per block of the generator
+const int   GEN_CLUSTERS    = 64;
+const float GEN_SPREAD      = 0.25f;
+const float GEN_TAIL        = 3.0f;
+
+const int   MEM_LOAD      = 0;		// phase: read data, query and truth sets
+const int   MEM_BUILD     = 1;		// phase: build index
+const int   MEM_QUERY     = 2;		// phase: c-k-AFN search
+const int   MEM_PHASES    = 3;		// number of phases
+
+// dimensions with their own kernels (cf. get_l2_dist_func() in util.h)
+#define KERNEL_DIMS(X) X(50) X(128) X(256) X(960)
 
 const int   SIZEBOOL      = (int) sizeof(bool);
 const int   SIZECHAR      = (int) sizeof(char);
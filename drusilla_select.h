@@ -8,6 +8,7 @@
 #include "def.h"
 #include "util.h"
 #include "pri_queue.h"
+#include "dd_select.h"
 
 class MaxK_List;
 
@@ -21,7 +22,10 @@ public:
 		int   d,						// number of dimensions
 		int   l,						// number of projections
 		int   m,						// number of candidates on each proj
-		const float *data);				// data objects
+		bool  fold,						// fold centering into the math?
+		bool  packed,					// pack candidates contiguously?
+		const float *data,				// data objects
+		const int *cand = NULL);		// selected candidates (NULL: select)
 	
 	// -------------------------------------------------------------------------
 	~Drusilla_Select();				// destrcutor
@@ -40,6 +44,7 @@ public:
 		int64_t ret = 0;
 		ret += sizeof(*this);
 		ret += SIZEINT * l_ * m_;	// cand_
+		if (cand_data_ != NULL) ret += SIZEFLOAT * l_ * m_ * dim_; // cand_data_
 		return ret;
 	}
 
@@ -48,13 +53,10 @@ protected:
 	int   dim_;						// dimensionality
 	int   l_;						// number of projections
 	int   m_;						// number of candidates for each proj
+	bool  fold_;					// fold centering into the math?
 	int   *cand_;					// furthest neighbor candidates	
-	const float *data_;				// data objects
-
-	// -------------------------------------------------------------------------
-	void calc_shift_data(			// calculate shift data objects
-		int   &max_id,					// data id with max l2-norm (return)
-		float &max_norm,				// max l2-norm (return)
-		float *norm,					// l2-norm of shift data (return)
-		float *shift_data); 			// shift data (return)
+	float *cand_data_;				// packed candidates (NULL if not packed)
+	const float *data_;				// data objects (NULL if packed)
+	Dist_Func  l2_dist_;			// calc_l2_dist() for dim_
+	Batch_Func l2_dist_batch_;		// calc_l2_dist_batch() for dim_
 };
@@ -0,0 +1,122 @@
+#include "gen.h"
+
+// -----------------------------------------------------------------------------
+static void gen_block(				// generate one block of objects
+	int   num,							// number of objects in the block
+	int   d,							// dimensionality
+	int   dist,							// distribution
+	uint64_t seed,						// random seed of the block
+	const float *center,				// cluster centers (GEN_CLUSTERED)
+	float *x)							// objects (return)
+{
+	Random_Gen rng(seed);
+	rng.gaussian(num * d, 0.0f, 1.0f, x);
+
+	for (int i = 0; i < num; ++i) {
+		float *y = &x[i * d];
+		if (dist == GEN_ANISOTROPIC) {
+			for (int j = 0; j < d; ++j) y[j] /= sqrt((float) (j + 1));
+		}
+		else if (dist == GEN_CLUSTERED) {
+			const float *c = &center[(rng.next() % GEN_CLUSTERS) * d];
+			for (int j = 0; j < d; ++j) y[j] = c[j] + GEN_SPREAD * y[j];
+		}
+		else if (dist == GEN_SHELLS) {
+			float norm = sqrt(calc_inner_product(d, y, y));
+			float r = sqrt((float) d) * 
+				pow(1.0f - rng.uniform(0.0f, 1.0f), -1.0f / GEN_TAIL);
+			if (norm > CHECK_ERROR) {
+				for (int j = 0; j < d; ++j) y[j] *= r / norm;
+			}
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+//  write n objects block by block: a batch of blocks is generated in parallel 
+//  and then written in order, so the memory is bounded by the batch
+// -----------------------------------------------------------------------------
+static int gen_set(					// generate and write one set
+	int   n,							// number of objects
+	int   d,							// dimensionality
+	int   dist,							// distribution
+	uint64_t seed,						// random seed of the set
+	const float *center,				// cluster centers (GEN_CLUSTERED)
+	const char *fname)					// address of the set (return)
+{
+	FILE *fp = fopen(fname, "wb");
+	if (!fp) { printf("Could not create %s\n", fname); return 1; }
+
+	int   num_block = (n + GEN_BLOCK - 1) / GEN_BLOCK;
+	int   batch = 4 * get_num_threads();
+	float *buf  = new float[(int64_t) batch * GEN_BLOCK * d];
+
+	int ret = 0;
+	for (int b = 0; b < num_block && ret == 0; b += batch) {
+		int num = MIN(batch, num_block - b);
+
+		#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < num; ++i) {
+			int64_t s = (int64_t) (b + i) * GEN_BLOCK;
+			int cnt = (int) MIN((int64_t) GEN_BLOCK, n - s);
+			gen_block(cnt, d, dist, seed + 2 * (uint64_t) (b + i), center, 
+				&buf[(int64_t) i * GEN_BLOCK * d]);
+		}
+		int64_t s = (int64_t) b * GEN_BLOCK;
+		int64_t e = MIN((int64_t) (b + num) * GEN_BLOCK, (int64_t) n);
+		int64_t size = (e - s) * d;
+		if ((int64_t) fwrite(buf, SIZEFLOAT, size, fp) != size) {
+			printf("Could not write %s\n", fname);
+			ret = 1;
+		}
+	}
+	fclose(fp);
+	delete[] buf;
+
+	return ret;
+}
+
+// -----------------------------------------------------------------------------
+int gen_data(						// generate a synthetic data set
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	int   dist,							// distribution (GEN_ISOTROPIC, ...)
+	int   seed,							// random seed
+	const char *data_set,				// address of data  set (return)
+	const char *query_set)				// address of query set (return)
+{
+	const char *name[] = { "Isotropic", "Anisotropic", "Clustered", "Shells" };
+	printf("Generate %s Data: n = %d, qn = %d, d = %d, seed = %d\n", 
+		name[dist], n, qn, d, seed);
+
+	// -------------------------------------------------------------------------
+	//  the cluster centers are shared by the data set and query set
+	// -------------------------------------------------------------------------
+	float *center = NULL;
+	if (dist == GEN_CLUSTERED) {
+		Random_Gen rng(seed);
+		center = new float[GEN_CLUSTERS * d];
+		rng.gaussian(GEN_CLUSTERS * d, 0.0f, 1.0f, center);
+	}
+
+	// -------------------------------------------------------------------------
+	//  the blocks of the data set and query set use the odd and even seeds 
+	//  after <seed>, so they never share a random stream
+	// -------------------------------------------------------------------------
+	double start_time = get_cur_time();
+	int ret = gen_set(n, d, dist, (uint64_t) seed + 1, center, data_set);
+	if (ret == 0) {
+		double t = (get_cur_time() - start_time) / 1000.0;
+		printf("Generate Data:  %f Seconds (%.1f MB/s)\n", t, 
+			(double) n * d * SIZEFLOAT / 1048576.0 / MAX(t, 1e-6));
+
+		start_time = get_cur_time();
+		ret = gen_set(qn, d, dist, (uint64_t) seed + 2, center, query_set);
+		printf("Generate Query: %f Seconds\n\n", 
+			(get_cur_time() - start_time) / 1000.0);
+	}
+	delete[] center;
+
+	return ret;
+}
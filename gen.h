@@ -0,0 +1,42 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+#include <sys/time.h>
+
+#include "def.h"
+#include "util.h"
+#include "random.h"
+
+// -----------------------------------------------------------------------------
+//  synthetic data sets for scaling benchmarks: the data set and query set are 
+//  drawn from the same distribution (both in the binary format of 
+//  read_bin_data()), which is one of
+//
+//  GEN_ISOTROPIC:   x ~ N(0, I)
+//
+//  GEN_ANISOTROPIC: x_j ~ N(0, 1/(j+1)), i.e., the variance decays along the 
+//                   dimensions as in real data with a skewed spectrum
+//
+//  GEN_CLUSTERED:   x = c + GEN_SPREAD * N(0, I), where c is one of 
+//                   GEN_CLUSTERS centers drawn from N(0, I)
+//
+//  GEN_SHELLS:      x = r * u, where u is uniform on the unit sphere and 
+//                   r = sqrt(d) * Pareto(GEN_TAIL) >= sqrt(d), so most points 
+//                   lie close to one shell and a heavy tail lies far away
+//
+//  The objects are generated in blocks of GEN_BLOCK, and each block has its 
+//  own Random_Gen seeded by (seed, block id), so the files are reproducible 
+//  given the seed, no matter how many threads generate them.
+// -----------------------------------------------------------------------------
+int gen_data(						// generate a synthetic data set
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	int   dist,							// distribution (GEN_ISOTROPIC, ...)
+	int   seed,							// random seed
+	const char *data_set,				// address of data  set (return)
+	const char *query_set);				// address of query set (return)
@@ -7,6 +7,9 @@
 #include "def.h"
 #include "util.h"
 #include "afn.h"
+#include "bench.h"
+#include "tuner.h"
+#include "gen.h"
 
 // -----------------------------------------------------------------------------
 void usage() 						// usage of the package
@@ -15,13 +18,32 @@ void usage() 						// usage of the package
 		"--------------------------------------------------------------------\n"
 		" Usage of the Package for Internal c-k-AFN Search:                  \n"
 		"--------------------------------------------------------------------\n"
-		"    -alg   (integer)   options of algorithms (0 - 6)\n"
+		"    -alg   (integer)   options of algorithms (0 - 11)\n"
 		"    -n     (integer)   number of data  objects\n"
 		"    -qn    (integer)   number of query objects\n"
 		"    -d     (integer)   dimensionality\n"
 		"    -L	    (integer)   number of projection\n"
 		"    -M     (integer)   number of candidates\n"
 		"    -c     (real)      approximation ratio (c > 1)\n"
+		"    -fc    (integer)   fold centering into the math (0 or 1)\n"
+		"    -pk    (integer)   pack candidates contiguously (0 or 1)\n"
+		"    -lz    (integer)   max #blocks kept, built on demand (0: build all)\n"
+		"    -cn    (integer)   calibrate N_THRESHOLD at startup (0 or 1)\n"
+		"    -pt    (integer)   partition by LAMBDA (0) or by cost model (1)\n"
+		"    -pj    (integer)   projections: dense (0), sparse (1), Hadamard (2)\n"
+		"    -sm    (integer)   stream data into the index build (0 or 1)\n"
+		"    -hp    (integer)   index arena on huge pages (0 or 1)\n"
+		"    -lt    (integer)   dump per-query latency (0 or 1)\n"
+		"    -ig    (integer)   number of interleaved queries (RQALSH family)\n"
+		"    -cb    (integer)   candidate budget per query (RQALSH family)\n"
+		"    -dl    (real)      deadline (ms) per query (RQALSH family)\n"
+		"    -k     (integer)   top-k value for tuning (1 - 10)\n"
+		"    -rc    (real)      target recall (%%) for tuning\n"
+		"    -rr    (real)      target overall ratio for tuning\n"
+		"    -tm    (integer)   method for tuning (0 - all, 2 - 6)\n"
+		"    -dt    (integer)   distribution: isotropic (0), anisotropic (1),\n"
+		"                       clustered (2), heavy-tailed shells (3)\n"
+		"    -sd    (integer)   random seed of the generator\n"
 		"    -ds    (string)    address of data  set\n"
 		"    -qs    (string)    address of query set\n"
 		"    -ts    (string)    address of truth set\n"
@@ -34,22 +56,40 @@ void usage() 						// usage of the package
 		"        Params: -alg 0 -n -qn -d -ds -qs -ts\n"
 		"\n"
 		"    1 - Linear Scan\n"
-		"        Params: -alg 1 -n -qn -d -ds -qs -ts -op\n"
+		"        Params: -alg 1 -n -qn -d [-lt] -ds -qs -ts -op\n"
 		"\n"
 		"    2 - QDAFN\n"
-		"        Params: -alg 2 -n -qn -d -L -M -c -ds -qs -ts -op\n"
+		"        Params: -alg 2 -n -qn -d -L -M -c [-pj -sm -lt] -ds -qs -ts -op\n"
 		"\n"
 		"    3 - Drusilla Select\n"
-		"        Params: -alg 3 -n -qn -d -L -M -ds -qs -ts -op\n"
+		"        Params: -alg 3 -n -qn -d -L -M [-fc -pk -lt] -ds -qs -ts -op\n"
 		"\n"
 		"    4 - RQALSH\n"
-		"        Params: -alg 4 -n -qn -d -c -ds -qs -ts -op\n"
+		"        Params: -alg 4 -n -qn -d -c [-pj -sm -lt -ig -cb -dl] -ds -qs -ts\n"
+		"                -op\n"
 		"\n"
 		"    5 - RQALSH*\n"
-		"        Params: -alg 5 -n -qn -d -L -M -c -ds -qs -ts -op\n"
+		"        Params: -alg 5 -n -qn -d -L -M -c [-fc -pk -pj -lt -ig\n"
+		"                -cb -dl] -ds -qs -ts -op\n"
 		"\n"
 		"    6 - ML_RQALSH\n"
-		"        Params: -alg 6 -n -qn -d -c -ds -qs -ts -op\n"
+		"        Params: -alg 6 -n -qn -d -c [-lz -cn -pt -pj -hp -lt -ig -cb\n"
+		"                -dl] -ds -qs -ts -op\n"
+		"\n"
+		"    7 - Benchmark of Candidate Merge of QDAFN\n"
+		"        Params: -alg 7 -n -qn -c -op\n"
+		"\n"
+		"    8 - Parameter Tuning (query set is the held-out sample)\n"
+		"        Params: -alg 8 -n -qn -d -k -rc -rr -tm [-c -fc -pk] -ds -qs -ts -op\n"
+		"\n"
+		"    9 - Benchmark of Table Scan (Prefetch, Interleaving) of RQALSH\n"
+		"        Params: -alg 9 -n -qn -d -c -ds -qs -op\n"
+		"\n"
+		"    10 - Benchmark of Dimension-Specialized Kernels\n"
+		"        Params: -alg 10 -n -qn -op\n"
+		"\n"
+		"    11 - Synthetic Data Generator (writes -ds and -qs)\n"
+		"        Params: -alg 11 -n -qn -d [-dt -sd] -ds -qs\n"
 		"\n"
 		"--------------------------------------------------------------------\n"
 		" Author: Qiang HUANG  (huangq2011@gmail.com)                        \n"
@@ -66,7 +106,7 @@ int main(int nargs, char** args)
 	char   data_set[200];			// address of data  set
 	char   query_set[200];			// address of query set
 	char   truth_set[200];			// address of truth set
-	char   out_path[200];			// output path
+	char   out_path[200] = "";		// output path
 
 	int    alg    = -1;				// option of algorithm
 	int    n      = -1;				// cardinality
@@ -75,6 +115,17 @@ int main(int nargs, char** args)
 	int    L      = -1;				// number of projection
 	int    M      = -1;				// number of candidates
 	float  ratio  = -1.0f;			// approximation ratio
+	bool   fold   = false;			// fold centering into the math?
+	bool   packed = false;			// pack candidates contiguously?
+	int    lazy   = 0;				// max #blocks kept (0: build all)
+	bool   calib  = false;			// calibrate N_THRESHOLD at startup?
+	bool   adapt  = false;			// partition ML_RQALSH by cost model?
+	int    top_k  = MAXK;			// top-k value for tuning
+	int    method = 0;				// method for tuning
+	float  t_recall = 0.0f;			// target recall (%) for tuning
+	float  t_ratio  = -1.0f;		// target overall ratio for tuning
+	int    dist   = GEN_ISOTROPIC;	// distribution of synthetic data
+	int    seed   = MAGIC;			// random seed of synthetic data
 	float  *data  = NULL;			// data set
 	float  *query = NULL;			// query set
 	Result *R     = NULL;			// k-NN ground truth
@@ -116,6 +167,86 @@ int main(int nargs, char** args)
 			printf("c         = %.1f\n", ratio);
 			assert(ratio > 1.0f);
 		}
+		else if (strcmp(args[cnt], "-fc") == 0) {
+			fold = atoi(args[++cnt]) != 0;
+			printf("fold      = %d\n", fold);
+		}
+		else if (strcmp(args[cnt], "-pk") == 0) {
+			packed = atoi(args[++cnt]) != 0;
+			printf("packed    = %d\n", packed);
+		}
+		else if (strcmp(args[cnt], "-lz") == 0) {
+			lazy = atoi(args[++cnt]);
+			printf("lazy      = %d\n", lazy);
+			assert(lazy >= 0);
+		}
+		else if (strcmp(args[cnt], "-pt") == 0) {
+			adapt = atoi(args[++cnt]) != 0;
+			printf("adaptive  = %d\n", adapt);
+		}
+		else if (strcmp(args[cnt], "-cn") == 0) {
+			calib = atoi(args[++cnt]) != 0;
+			printf("calibrate = %d\n", calib);
+		}
+		else if (strcmp(args[cnt], "-pj") == 0) {
+			g_proj = atoi(args[++cnt]);
+			printf("proj      = %d\n", g_proj);
+			assert(g_proj >= PROJ_DENSE && g_proj <= PROJ_HADAMARD);
+		}
+		else if (strcmp(args[cnt], "-sm") == 0) {
+			g_stream = atoi(args[++cnt]) != 0;
+			printf("stream    = %d\n", g_stream);
+		}
+		else if (strcmp(args[cnt], "-hp") == 0) {
+			g_hugepage = atoi(args[++cnt]) != 0;
+			printf("hugepage  = %d\n", g_hugepage);
+		}
+		else if (strcmp(args[cnt], "-lt") == 0) {
+			g_dump_latency = atoi(args[++cnt]) != 0;
+			printf("latency   = %d\n", g_dump_latency);
+		}
+		else if (strcmp(args[cnt], "-ig") == 0) {
+			g_group = atoi(args[++cnt]);
+			printf("group     = %d\n", g_group);
+			assert(g_group > 0);
+		}
+		else if (strcmp(args[cnt], "-cb") == 0) {
+			g_budget = atoi(args[++cnt]);
+			printf("budget    = %d\n", g_budget);
+			assert(g_budget >= 0);
+		}
+		else if (strcmp(args[cnt], "-dl") == 0) {
+			g_deadline = (float) atof(args[++cnt]);
+			printf("deadline  = %.3f\n", g_deadline);
+			assert(g_deadline >= 0.0f);
+		}
+		else if (strcmp(args[cnt], "-k") == 0) {
+			top_k = atoi(args[++cnt]);
+			printf("k         = %d\n", top_k);
+			assert(top_k > 0 && top_k <= MAXK);
+		}
+		else if (strcmp(args[cnt], "-rc") == 0) {
+			t_recall = (float) atof(args[++cnt]);
+			printf("recall    = %.2f\n", t_recall);
+		}
+		else if (strcmp(args[cnt], "-rr") == 0) {
+			t_ratio = (float) atof(args[++cnt]);
+			printf("ratio     = %.4f\n", t_ratio);
+		}
+		else if (strcmp(args[cnt], "-tm") == 0) {
+			method = atoi(args[++cnt]);
+			printf("method    = %d\n", method);
+			assert(method == 0 || (method >= 2 && method <= 6));
+		}
+		else if (strcmp(args[cnt], "-dt") == 0) {
+			dist = atoi(args[++cnt]);
+			printf("dist      = %d\n", dist);
+			assert(dist >= GEN_ISOTROPIC && dist <= GEN_SHELLS);
+		}
+		else if (strcmp(args[cnt], "-sd") == 0) {
+			seed = atoi(args[++cnt]);
+			printf("seed      = %d\n", seed);
+		}
 		else if (strcmp(args[cnt], "-ds") == 0) {
 			strncpy(data_set, args[++cnt], sizeof(data_set));
 			printf("data_set  = %s\n", data_set);
@@ -150,16 +281,30 @@ int main(int nargs, char** args)
 	// -------------------------------------------------------------------------
 	//  read data set, query set, and truth set (optional)
 	// -------------------------------------------------------------------------
-	data = new float[n * d];
-	if (read_bin_data(n, d, true, data_set, data)) exit(1);
-
-	query = new float[qn * d];
-	if (read_bin_data(qn, d, false, query_set, query)) exit(1);
+	begin_mem_phase(MEM_LOAD);
+	TRACE_BEGIN("load", n);
+	if (alg != 7 && alg != 10 && alg != 11) {
+		// -sm: alg 2 and 4 read the data set while building the index
+		data = new float[(int64_t) n * d];
+		if (!g_stream || (alg != 2 && alg != 4)) {
+			if (read_bin_data(n, d, true, data_set, data)) exit(1);
+		}
 
-	if (alg > 0) {
+		query = new float[qn * d];
+		if (read_bin_data(qn, d, false, query_set, query)) exit(1);
+	}
+	if (alg > 0 && alg != 7 && alg != 9 && alg != 10 && alg != 11) {
 		R = new Result[qn * MAXK];
 		if (read_ground_truth(qn, truth_set, R)) exit(1);
 	}
+	TRACE_END();
+	end_mem_phase(MEM_LOAD);
+	if (calib) {
+		double start = get_cur_time();
+		g_n_threshold = calibrate_n_threshold(d, ratio, g_proj);
+		printf("N_THRESHOLD = %d (calibrated in %f Seconds)\n\n", 
+			g_n_threshold, (get_cur_time() - start) / 1000.0);
+	}
 
 	// -------------------------------------------------------------------------
 	//  methods
@@ -174,36 +319,59 @@ int main(int nargs, char** args)
 			(const Result*) R, out_path);
 		break;
 	case 2:
-		qdafn(n, qn, d, L, M, ratio, (const float*) data, (const float*) query, 
+		qdafn(n, qn, d, L, M, ratio, data_set, data, (const float*) query, 
 			(const Result*) R, out_path);
 		break;
 	case 3:
-		drusilla_select(n, qn, d, L, M, (const float*) data, (const float*) query, 
-			(const Result*) R, out_path);
+		drusilla_select(n, qn, d, L, M, fold, packed, (const float*) data, 
+			(const float*) query, (const Result*) R, out_path);
 		break;
 	case 4:
-		rqalsh(n, qn, d, ratio, (const float*) data, (const float*) query, 
+		rqalsh(n, qn, d, ratio, data_set, data, (const float*) query, 
 			(const Result*) R, out_path);
 		break;
 	case 5:
-		rqalsh_star(n, qn, d, L, M, ratio, (const float*) data, (const float*) query, 
-			(const Result*) R, out_path);
+		rqalsh_star(n, qn, d, L, M, ratio, fold, packed, (const float*) data, 
+			(const float*) query, (const Result*) R, out_path);
 		break;
 	case 6:
-		ml_rqalsh(n, qn, d, ratio, (const float*) data, (const float*) query, 
-			(const Result*) R, out_path);
+		ml_rqalsh(n, qn, d, ratio, lazy, adapt, (const float*) data, 
+			(const float*) query, (const Result*) R, out_path);
+		break;
+	case 7:
+		merge_bench(n, qn, ratio, out_path);
+		break;
+	case 8:
+		tune(n, qn, d, top_k, method, ratio, fold, packed, t_recall, t_ratio, 
+			(const float*) data, (const float*) query, (const Result*) R, 
+			out_path);
+		break;
+	case 9:
+		scan_bench(n, qn, d, ratio, (const float*) data, (const float*) query, 
+			out_path);
+		break;
+	case 10:
+		kernel_bench(n, qn, out_path);
+		break;
+	case 11:
+		gen_data(n, qn, d, dist, seed, data_set, query_set);
 		break;
 	default:
 		printf("Parameters Error!\n");
 		usage();
 		break;
 	}
+#ifdef RQALSH_TRACE
+	char trace_set[200]; sprintf(trace_set, "%strace.json", out_path);
+	TRACE_WRITE(trace_set);
+#endif
+
 	// -------------------------------------------------------------------------
 	//  release space
 	// -------------------------------------------------------------------------
-	delete[] data;
-	delete[] query;
-	if (alg > 0) delete[] R;
+	if (data  != NULL) delete[] data;
+	if (query != NULL) delete[] query;
+	if (R     != NULL) delete[] R;
 
 	return 0;
 }
@@ -5,12 +5,20 @@ ML_RQALSH::ML_RQALSH(				// constructor
 	int   n,							// cardinality
 	int   d,							// dimensionality
 	float ratio,						// approximation ratio
-	const float *data)					// data objects
-	: n_pts_(n), dim_(d), ratio_(ratio), data_(data)
+	int   max_blocks,					// max #blocks kept (0: build all)
+	bool  adaptive,						// partition by cost model?
+	const float *data,					// data objects
+	int   proj,							// projection family
+	int   n_thres,						// max #objects scanned exactly
+	bool  hugepage)						// arena on huge pages?
+	: n_pts_(n), dim_(d), ratio_(ratio), data_(data), proj_(proj), 
+	n_thres_(n_thres), adaptive_(adaptive), max_blocks_(max_blocks), 
+	num_built_(0), num_builds_(0), tick_(0)
 {
 	// -------------------------------------------------------------------------
 	//  calculate the centroid of data obejcts
 	// -------------------------------------------------------------------------
+	TRACE_BEGIN("centroid", n);
 	centroid_ = new float[d];
 	for (int i = 0; i < d; ++i) centroid_[i] = 0.0f;
 
@@ -20,11 +28,14 @@ ML_RQALSH::ML_RQALSH(				// constructor
 		}
 	}
 	for (int i = 0; i < d; ++i) centroid_[i] /= n;
+	TRACE_END();
 
 	// -------------------------------------------------------------------------
 	//  reorder data objects by their l2-dist to centroid (descending order)
 	// -------------------------------------------------------------------------
+	TRACE_BEGIN("sort by radius", n);
 	Result *arr = new Result[n];
+	#pragma omp parallel for
 	for (int i = 0; i < n; ++i) {
 		arr[i].id_  = i;
 		arr[i].key_ = calc_l2_dist(d, &data_[i*d], centroid_);
@@ -33,10 +44,108 @@ ML_RQALSH::ML_RQALSH(				// constructor
 
 	sorted_id_ = new int[n];
 	for (int i = 0; i < n; ++i) sorted_id_[i] = arr[i].id_;
+	TRACE_END();
 
 	// -------------------------------------------------------------------------
 	//  multi-level partition
 	// -------------------------------------------------------------------------
+	TRACE_BEGIN("partition");
+	if (adaptive_) partition_by_cost(arr);
+	else partition_by_lambda(arr);
+	assert(block_start_.back() == n);
+	TRACE_END();
+
+	// -------------------------------------------------------------------------
+	//  calculate the bounding sphere of each block: the blocks are thin shells 
+	//  around the global centroid, so the sphere around their own centroid is 
+	//  much tighter for the queries which are not close to the global centroid
+	// -------------------------------------------------------------------------
+	int num_blocks = (int) radius_.size();
+	TRACE_BEGIN("block spheres", num_blocks);
+	block_ctr_ = new float[num_blocks * d];
+	block_r_.resize(num_blocks, 0.0f);
+
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < num_blocks; ++i) {
+		int cnt = block_start_[i+1] - block_start_[i];
+		const int *index = (const int*) sorted_id_ + block_start_[i];
+
+		float *ctr = &block_ctr_[i*d];
+		for (int j = 0; j < d; ++j) ctr[j] = 0.0f;
+		for (int k = 0; k < cnt; ++k) {
+			const float *point = &data_[(int64_t) index[k]*d];
+			for (int j = 0; j < d; ++j) ctr[j] += point[j];
+		}
+		for (int j = 0; j < d; ++j) ctr[j] /= cnt;
+
+		float r = 0.0f;
+		for (int k = 0; k < cnt; ++k) {
+			float dist = calc_l2_dist(d, &data_[(int64_t) index[k]*d], ctr);
+			if (dist > r) r = dist;
+		}
+		block_r_[i] = r;
+	}
+	TRACE_END();
+
+	// -------------------------------------------------------------------------
+	//  generate the bank of hash functions shared by all blocks: a block of 
+	//  n objects uses the first m(n) ones, so a query is projected only once 
+	//  for all the blocks it visits
+	// -------------------------------------------------------------------------
+	bank_m_ = 0;
+	int64_t arena_size = 0;				// blocks, their tables and packed rows
+	for (int i = 0; i < num_blocks; ++i) {
+		int cnt = block_start_[i+1] - block_start_[i];
+		int64_t size = (int64_t) cnt * d * SIZEFLOAT;
+		if (cnt > n_thres_) {
+			float w; int m, l;
+			calc_rqalsh_params(cnt, ratio, w, m, l);
+			bank_m_ = MAX(bank_m_, m);
+			size = (int64_t) m * cnt * sizeof(Result);
+		}
+		arena_size += (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+		arena_size += (sizeof(RQALSH) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	}
+	bank_ = NULL;
+	if (bank_m_ > 0) {
+		Random_Gen rng(MAGIC);
+		bank_ = new Projection(bank_m_, d, proj_, 1.0f, rng);
+	}
+
+	// -------------------------------------------------------------------------
+	//  build rqalsh for each block: the blocks only read the bank, so they 
+	//  can be built in parallel. In lazy mode (max_blocks > 0), a block is 
+	//  built on its first access instead, and it is the same block whenever 
+	//  it is (re)built.
+	// -------------------------------------------------------------------------
+	lsh_.resize(num_blocks, NULL);
+	last_use_.resize(num_blocks, 0);
+	use_cnt_.resize(num_blocks, 0);
+
+	// the blocks themselves, their tables and packed rows are allocated from 
+	// one arena, which is sized for all of them; in lazy mode, the evicted 
+	// blocks must free their own memory, so they stay on the heap
+	arena_ = NULL;
+	if (max_blocks_ <= 0) {
+		arena_ = new Arena(arena_size, hugepage);
+
+		TRACE_SCOPE("blocks", num_blocks);
+		#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < num_blocks; ++i) build_block(i);
+		num_built_ = num_builds_ = num_blocks;
+	}
+	delete[] arr;
+}
+
+// -----------------------------------------------------------------------------
+//  fixed partition: each block starts from the furthest object left, and it 
+//  takes the objects whose l2-dist to centroid is larger than LAMBDA times of 
+//  the first one (at most MAX_BLOCK_NUM objects)
+// -----------------------------------------------------------------------------
+void ML_RQALSH::partition_by_lambda( // partition by LAMBDA
+	const Result *arr)					// objects sorted by l2-dist to centroid
+{
+	int n = n_pts_;
 	int start = 0;	
 	while (start < n) {
 		//  get index for each block
@@ -49,28 +158,187 @@ ML_RQALSH::ML_RQALSH(				// constructor
 			++idx;
 			if (++cnt >= MAX_BLOCK_NUM) break; 
 		}
-		// build rqalsh for each block
-		const int *index = (const int*) sorted_id_ + start;
-		RQALSH *lsh = new RQALSH(cnt, d, ratio, index, data);
-		
+		// consecutive small blocks are coalesced into one segment, which is 
+		// scanned by one batch loop over its packed data objects
+		int last = (int) radius_.size() - 1;
+		if (last >= 0 && start - block_start_[last] + cnt <= n_thres_) {
+			start += cnt;
+			continue;
+		}
 		// update info
-		lsh_.push_back(lsh);
+		block_start_.push_back(start);
 		radius_.push_back(radius);
 		start += cnt;
 	}
-	assert(start == n);
-	delete[] arr;
+	block_start_.push_back(start);
+}
+
+// -----------------------------------------------------------------------------
+//  expected cost of one visit of a block of n objects, in the cost of one 
+//  dimension of distance computation: a small block is scanned exactly, and 
+//  otherwise rqalsh projects the query m times, scans about SCAN_FRAC of each 
+//  table at ENTRY_COST per entry (cf. Scanned/Table of make STATS=1), and 
+//  verifies CANDIDATES + MAXK - 1 objects
+// -----------------------------------------------------------------------------
+double ML_RQALSH::calc_block_cost(	// calc expected cost of one block visit
+	int   n)							// number of objects in the block
+{
+	if (n <= n_thres_) return (double) n * dim_;
+
+	float w = -1.0f;
+	int   m = -1, l = -1;
+	calc_rqalsh_params(n, ratio_, w, m, l);
+
+	return (double) m * dim_ + (double) ENTRY_COST * SCAN_FRAC * m * n + 
+		(double) (CANDIDATES + MAXK - 1) * dim_;
+}
+
+// -----------------------------------------------------------------------------
+//  cost-model partition: the shell boundaries minimize the expected query 
+//  cost sum_i P(i) * C(n_i), where C(n_i) is the cost of one visit of block i 
+//  and P(i) is the probability that a query visits it. A query q visits the 
+//  blocks in descending order of the upper bound until the k-th furthest 
+//  distance r satisfies c * r >= R_i + |q,o|, where R_i is the radius of the 
+//  i-th block. P(i) is estimated by a sample of NUM_SAMPLE data objects, and 
+//  r_q is taken as the furthest distance to the objects before the i-th block 
+//  (as if the blocks before were scanned exactly). More blocks prune more, 
+//  but every block visited pays its own projection and verification. As the 
+//  model only counts cost, a cut which is not in the fixed partition is only 
+//  allowed if no sample query may stop there before its furthest neighbor, 
+//  i.e., c * r_q >= |q,fn(q)| while fn(q) is in or after the block (blocks 
+//  are also pruned by their own spheres, so R_i + |q,o| cannot be used here).
+//
+//  The boundaries are chosen by dynamic programming over the cut positions 
+//  where the radius crosses R_0 * GRID_RATIO^j and the cut positions of the 
+//  fixed partition, so the result is never worse than the fixed one under the 
+//  model. A block with rqalsh keeps the LAMBDA and MAX_BLOCK_NUM limits of 
+//  the fixed partition, while a block scanned exactly can be of any width.
+// -----------------------------------------------------------------------------
+void ML_RQALSH::partition_by_cost(	// partition by cost model
+	const Result *arr)					// objects sorted by l2-dist to centroid
+{
+	int n = n_pts_;
+	int d = dim_;
+
+	// -------------------------------------------------------------------------
+	//  candidate cut positions: the fixed partition and the radius grid
+	// -------------------------------------------------------------------------
+	partition_by_lambda(arr);
+	std::vector<int> fixed(block_start_);
+	std::vector<int> pos(block_start_);
+	block_start_.clear();
+	radius_.clear();
+
+	double log_grid = log(GRID_RATIO);
+	int last_cell = 0;
+	for (int i = 1; i < n; ++i) {
+		if (arr[i].key_ <= 0.0f) break;
+		int cell = (int) floor(log(arr[i].key_ / arr[0].key_) / log_grid);
+		if (cell != last_cell) { pos.push_back(i); last_cell = cell; }
+	}
+	std::sort(pos.begin(), pos.end());
+	pos.erase(std::unique(pos.begin(), pos.end()), pos.end());
+
+	// -------------------------------------------------------------------------
+	//  for the block starting at each cut position, count the sample queries 
+	//  which visit it, and the ones which may stop before it although their 
+	//  furthest neighbor is in or after it, where r_q is the furthest distance 
+	//  to the objects before the block
+	// -------------------------------------------------------------------------
+	int num = (int) pos.size();
+	int num_sample = MIN(NUM_SAMPLE, n);
+	std::vector<int> visit(num, 0);
+	std::vector<int> loss(num, 0);
+
+	#pragma omp parallel for
+	for (int i = 0; i < num_sample; ++i) {
+		const float *query = &data_[(int64_t) (i * (n / num_sample)) * d];
+		float dist2ctr = calc_l2_dist(d, query, centroid_);
+
+		float *dist = new float[n];
+		int   fn_pos = 0;
+		for (int k = 0; k < n; ++k) {
+			dist[k] = calc_l2_dist(d, query, &data_[(int64_t) arr[k].id_*d]);
+			if (dist[k] > dist[fn_pos]) fn_pos = k;
+		}
+		float fn = 0.0f;
+		for (int j = 0, k = 0; j < num - 1; ++j) {
+			for (; k < pos[j]; ++k) fn = MAX(fn, dist[k]);
+
+			if (j > 0 && fn_pos >= pos[j] && ratio_ * fn >= dist[fn_pos]) {
+				#pragma omp atomic
+				++loss[j];
+			}
+			if (j == 0 || ratio_ * fn < arr[pos[j]].key_ + dist2ctr) {
+				#pragma omp atomic
+				++visit[j];
+			}
+		}
+		delete[] dist;
+	}
+
+	// -------------------------------------------------------------------------
+	//  dynamic programming: f[j] is the min cost of the objects before pos[j]
+	// -------------------------------------------------------------------------
+	double *f   = new double[num];
+	int    *pre = new int[num];
+	for (int j = 0; j < num; ++j) { f[j] = MAXREAL; pre[j] = -1; }
+	f[0] = 0.0;
+
+	for (int i = 0; i < num - 1; ++i) {
+		if (f[i] >= MAXREAL) continue;
+
+		int    a = pos[i];
+		double prob = (double) visit[i] / num_sample;
+		for (int j = i + 1; j < num; ++j) {
+			int size = pos[j] - a;
+			if (size > n_thres_ && (size > MAX_BLOCK_NUM || 
+				arr[pos[j]-1].key_ <= LAMBDA * arr[a].key_)) break;
+
+			// a new cut must not prune the furthest neighbor of any sample
+			if (loss[j] > 0 && j < num - 1 && 
+				!std::binary_search(fixed.begin(), fixed.end(), pos[j])) continue;
+
+			double cost = f[i] + prob * calc_block_cost(size);
+			if (cost < f[j]) { f[j] = cost; pre[j] = i; }
+		}
+	}
+	assert(pre[num-1] >= 0);
+
+	// -------------------------------------------------------------------------
+	//  get the blocks from the last cut position backward
+	// -------------------------------------------------------------------------
+	for (int j = num - 1; j > 0; j = pre[j]) block_start_.push_back(pos[j]);
+	block_start_.push_back(0);
+	std::reverse(block_start_.begin(), block_start_.end());
+
+	for (int i = 0; i + 1 < (int) block_start_.size(); ++i) {
+		radius_.push_back(arr[block_start_[i]].key_);
+	}
+	delete[] f;
+	delete[] pre;
 }
 
 // -----------------------------------------------------------------------------
 ML_RQALSH::~ML_RQALSH()				// destructor
 {
-	for (auto lsh : lsh_) { delete lsh; lsh = NULL; }
+	for (auto lsh : lsh_) {
+		if (lsh == NULL) continue;
+		if (arena_ != NULL) lsh->~RQALSH(); // its memory goes with the arena
+		else delete lsh;
+	}
 	lsh_.clear();    lsh_.shrink_to_fit();
 	radius_.clear(); radius_.shrink_to_fit();
+	block_r_.clear(); block_r_.shrink_to_fit();
+	block_start_.clear(); block_start_.shrink_to_fit();
+	last_use_.clear(); last_use_.shrink_to_fit();
+	use_cnt_.clear(); use_cnt_.shrink_to_fit();
+	if (bank_ != NULL) { delete bank_; bank_ = NULL; }
+	if (arena_ != NULL) { delete arena_; arena_ = NULL; }
 
 	delete[] sorted_id_; sorted_id_ = NULL;
 	delete[] centroid_;  centroid_  = NULL;
+	delete[] block_ctr_; block_ctr_ = NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -80,7 +348,64 @@ void ML_RQALSH::display()			// display parameters
 	printf("    n       = %d\n",   n_pts_);
 	printf("    d       = %d\n",   dim_);
 	printf("    c       = %.1f\n", ratio_);
-	printf("    #blocks = %d\n\n", (int) lsh_.size());
+	printf("    #blocks = %d\n", (int) lsh_.size());
+	printf("    #built  = %d\n", num_built_);
+	printf("    #hash   = %d (shared)\n", bank_m_);
+	printf("    adapt   = %d\n", adaptive_);
+	printf("    lazy    = %d\n\n", max_blocks_);
+}
+
+// -----------------------------------------------------------------------------
+void ML_RQALSH::build_block(		// build rqalsh for a block
+	int   i)							// block id
+{
+	TRACE_SCOPE("block", i);
+	int  cnt    = block_start_[i+1] - block_start_[i];
+	bool packed = cnt <= n_thres_; // exact scan over contiguous rows
+	const int *index = (const int*) sorted_id_ + block_start_[i];
+	if (arena_ != NULL) {
+		void *mem = arena_->alloc(sizeof(RQALSH));
+		lsh_[i] = new (mem) RQALSH(cnt, dim_, ratio_, index, data_, packed, 
+			MAGIC + i, proj_, bank_, arena_, n_thres_);
+	}
+	else {
+		lsh_[i] = new RQALSH(cnt, dim_, ratio_, index, data_, packed, 
+			MAGIC + i, proj_, bank_, arena_, n_thres_);
+	}
+}
+
+// -----------------------------------------------------------------------------
+//  get the rqalsh of a block: in lazy mode, the block is built if it is not 
+//  built yet, and once more than max_blocks_ blocks are built, the one with 
+//  the least #accesses * #objects, i.e., the least rebuild work saved so far, 
+//  is evicted (the least recently used one on ties). The access counts are 
+//  kept after eviction, so a hot block which has been evicted once is not 
+//  evicted again by the rarely used ones.
+// -----------------------------------------------------------------------------
+RQALSH* ML_RQALSH::get_block(		// get the rqalsh of a block
+	int   i)							// block id
+{
+	if (lsh_[i] == NULL) {
+		if (num_built_ >= max_blocks_) {
+			int victim = -1;
+			int64_t min_cost = 0;
+			for (int j = 0; j < (int) lsh_.size(); ++j) {
+				if (lsh_[j] == NULL) continue;
+				int64_t cost = use_cnt_[j] * (block_start_[j+1] - block_start_[j]);
+				if (victim >= 0 && cost > min_cost) continue;
+				if (victim >= 0 && cost == min_cost && 
+					last_use_[j] > last_use_[victim]) continue;
+				victim = j; min_cost = cost;
+			}
+			delete lsh_[victim]; lsh_[victim] = NULL;
+			--num_built_;
+		}
+		build_block(i);
+		++num_built_; ++num_builds_;
+	}
+	last_use_[i] = ++tick_;
+	++use_cnt_[i];
+	return lsh_[i];
 }
 
 // -----------------------------------------------------------------------------
@@ -89,18 +414,239 @@ int ML_RQALSH::kfn(					// c-k-AFN search
 	const float *query,					// input query
 	MaxK_List *list)					// top-k results (return)
 {
-	float dist2ctr = calc_l2_dist(dim_, centroid_, query);
+	int num = (int) lsh_.size();
+	Result *order = new Result[num];
+	get_order(query, order);
 	float radius = MINREAL;
+	float *q_val = NULL;				// hash values of query by bank_
 
 	int cnt = 0;
-	for (int i = 0; i < (int) lsh_.size(); ++i) {
+	for (int j = 0; j < num; ++j) {
+		// early stop pruning
+		int i = order[j].id_;
+		if (radius > order[j].key_ / ratio_) break;
+
+		// k-FN search by rqalsh on each block
+		RQALSH *lsh = get_block(i);
+		if (lsh->get_num_tables() > 0) q_val = project(query, q_val);
+		cnt += lsh->kfn(top_k, radius, query, list, q_val);
+		radius = list->min_key();
+	}
+	delete[] order;
+	if (q_val != NULL) delete[] q_val;
+	return cnt;
+}
+
+// -----------------------------------------------------------------------------
+//  get the upper bound of the distance from query to each block and sort the 
+//  blocks by it in descending order, i.e., the visiting order of the blocks. 
+//  The upper bound is the smaller one of the global bound radius_[i] + |q,o| 
+//  and the per-block bound block_r_[i] + |q,o_i|, where o is the centroid of 
+//  all data objects and o_i is the centroid of the i-th block.
+// -----------------------------------------------------------------------------
+void ML_RQALSH::get_order(			// get the visiting order of blocks
+	const float *query,					// input query
+	Result *order)						// blocks with upper bound (return)
+{
+	int   num = (int) lsh_.size();
+	float dist2ctr = calc_l2_dist(dim_, centroid_, query);
+
+	for (int i = 0; i < num; ++i) {
+		float ub1 = radius_[i] + dist2ctr;
+		float ub2 = block_r_[i] + calc_l2_dist(dim_, &block_ctr_[i*dim_], query);
+
+		order[i].id_  = i;
+		order[i].key_ = MIN(ub1, ub2);
+	}
+	qsort(order, num, sizeof(Result), ResultCompDesc);
+}
+
+// -----------------------------------------------------------------------------
+//  anytime c-k-AFN search: the candidate budget is global for the query and 
+//  is carried across blocks. The blocks are visited in the same order as kfn() 
+//  and each block gets a share of the rest budget by its margin ub - c * r 
+//  over the margins of the blocks which are not pruned yet, where r is the 
+//  k-th furthest distance so far, so the outer blocks (with larger ub) are 
+//  given more candidates, and the unused budget goes to the next block. The 
+//  small blocks are scanned exactly as before and do not use the budget.
+// -----------------------------------------------------------------------------
+int ML_RQALSH::kfn(					// c-k-AFN search with budget and deadline
+	int   top_k,						// top-k value
+	int   budget,						// candidate budget (0: per block)
+	double deadline,					// deadline by get_cur_time() (0: none)
+	const float *query,					// input query
+	MaxK_List *list,					// top-k results (return)
+	bool  &finished)					// terminated normally? (return)
+{
+	int num = (int) lsh_.size();
+	Result *order = new Result[num];
+	get_order(query, order);
+	float radius = MINREAL;
+
+	int cnt  = 0;						// number of verified candidates
+	int used = 0;						// budget used by lsh blocks
+	float *q_val = NULL;				// hash values of query by bank_
+	finished = true;
+	for (int j = 0; j < num; ++j) {
 		// early stop pruning
-		float ub = radius_[i] + dist2ctr;
+		int   i  = order[j].id_;
+		float ub = order[j].key_;
 		if (radius > ub / ratio_) break;
 
+		// stop if the budget is used up or the deadline has passed; small 
+		// blocks are scanned exactly and do not draw from the budget
+		int share = 0;
+		bool small = block_start_[i+1] - block_start_[i] <= n_thres_;
+		if (budget > 0 && !small) {
+			int rest = budget - used;
+			if (rest <= 0) { finished = false; break; }
+
+			share = rest;
+			if (radius > 0.0f) {
+				float thres  = radius * ratio_;
+				float margin = ub - thres;
+				float total  = 0.0f;
+				for (int l = j; l < num && order[l].key_ > thres; ++l) {
+					total += order[l].key_ - thres;
+				}
+				if (total > 0.0f) {
+					share = (int) ceil(rest * margin / total);
+					share = MAX(share, MIN(top_k, rest));
+				}
+			}
+		}
+		if (deadline > 0.0 && get_cur_time() > deadline) {
+			finished = false; break;
+		}
+
 		// k-FN search by rqalsh on each block
-		cnt += lsh_[i]->kfn(top_k, radius, query, list);
+		bool done = true;
+		RQALSH *lsh = get_block(i);
+		if (lsh->get_num_tables() > 0) q_val = project(query, q_val);
+		int check = lsh->kfn(top_k, radius, share, deadline, query, list, 
+			done, q_val);
+		if (!small) used += check;
+		if (!done) finished = false;	// block cut short by its share
+		cnt += check;
 		radius = list->min_key();
+		if (deadline > 0.0 && get_cur_time() > deadline) {
+			finished = false; break;
+		}
 	}
+	delete[] order;
+	if (q_val != NULL) delete[] q_val;
 	return cnt;
 }
+
+// -----------------------------------------------------------------------------
+void ML_RQALSH::kfn_group(			// interleaved c-k-AFN search of queries
+	int   top_k,						// top-k value
+	int   num,							// number of queries
+	const float **query,				// input queries
+	MaxK_List **list,					// top-k results (return)
+	int   *check)						// number of checked objects (return)
+{
+	int    num_b  = (int) lsh_.size();
+	Result *order = new Result[num * num_b];
+	Result *pair  = new Result[num];
+	float *radius = new float[num];
+	int   *idx    = new int[num];
+	int   *cnt    = new int[num];
+	float *g_R    = new float[num];
+	const float **g_query = new const float*[num];
+	const float **g_val   = new const float*[num];
+	MaxK_List   **g_list  = new MaxK_List*[num];
+	float **q_val = new float*[num];	// hash values of queries by bank_
+
+	for (int i = 0; i < num; ++i) {
+		get_order(query[i], &order[i*num_b]);
+		radius[i] = MINREAL;
+		check[i]  = 0;
+		q_val[i]  = NULL;
+	}
+	// each query visits the blocks in the same order as kfn(), one block per 
+	// round; the queries which visit the same block in a round are searched 
+	// on it as one group
+	for (int j = 0; j < num_b; ++j) {
+		int p_num = 0;
+		for (int i = 0; i < num; ++i) {
+			// early stop pruning
+			const Result &blk = order[i*num_b+j];
+			if (radius[i] > blk.key_ / ratio_) continue;
+
+			pair[p_num].id_  = i;
+			pair[p_num].key_ = (float) blk.id_;
+			++p_num;
+		}
+		if (p_num == 0) break;
+		qsort(pair, p_num, sizeof(Result), ResultComp);
+
+		for (int s = 0; s < p_num; ) {
+			int b = (int) pair[s].key_;
+			int g_num = 0;
+			for (; s < p_num && (int) pair[s].key_ == b; ++s) {
+				int i = pair[s].id_;
+				idx[g_num] = i;
+				g_R[g_num] = radius[i];
+				g_query[g_num] = query[i];
+				g_list[g_num]  = list[i];
+				++g_num;
+			}
+			// k-FN search by rqalsh on each block
+			RQALSH *lsh = get_block(b);
+			for (int i = 0; i < g_num && lsh->get_num_tables() > 0; ++i) {
+				q_val[idx[i]] = project(query[idx[i]], q_val[idx[i]]);
+				g_val[i] = q_val[idx[i]];
+			}
+			lsh->kfn_group(top_k, g_num, g_R, g_query, g_list, cnt, g_val);
+			for (int i = 0; i < g_num; ++i) {
+				check[idx[i]] += cnt[i];
+				radius[idx[i]] = list[idx[i]]->min_key();
+			}
+		}
+	}
+	delete[] order;
+	delete[] pair;
+	delete[] radius;
+	delete[] idx;
+	delete[] cnt;
+	delete[] g_R;
+	delete[] g_query;
+	delete[] g_val;
+	delete[] g_list;
+	for (int i = 0; i < num; ++i) {
+		if (q_val[i] != NULL) delete[] q_val[i];
+	}
+	delete[] q_val;
+}
+
+// -----------------------------------------------------------------------------
+float* ML_RQALSH::project(			// project query by bank_ (once)
+	const float *query,					// input query
+	float *q_val)						// hash values so far (NULL: not yet)
+{
+	if (q_val == NULL) {
+		q_val = new float[bank_m_];
+		bank_->project(query, q_val);
+	}
+	return q_val;
+}
+
+#ifdef RQALSH_STATS
+// -----------------------------------------------------------------------------
+void ML_RQALSH::display_stats(		// display search statistics per block
+	FILE *fp)							// output file
+{
+	Search_Stats total;
+	memset(&total, 0, sizeof(total));
+
+	int m = 0;
+	for (int i = 0; i < (int) lsh_.size(); ++i) {
+		if (lsh_[i] == NULL) continue;	// not built or evicted in lazy mode
+		lsh_[i]->display_stats(fp, i);
+		add_stats(lsh_[i]->get_stats(), total);
+		m += lsh_[i]->get_num_tables();
+	}
+	::display_stats(fp, -1, n_pts_, m, total);
+}
+#endif
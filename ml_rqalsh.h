@@ -5,6 +5,7 @@
 #include <cassert>
 #include <cmath>
 #include <cstring>
+#include <new>
 #include <vector>
 
 #include "def.h"
@@ -21,7 +22,12 @@ public:
 		int   n,						// cardinality
 		int   d,						// dimensionality
 		float ratio,					// approximation ratio
-    	const float *data);				// data objects
+		int   max_blocks,				// max #blocks kept (0: build all)
+		bool  adaptive,					// partition by cost model?
+    	const float *data,				// data objects
+		int   proj = PROJ_DENSE,		// projection family
+		int   n_thres = N_THRESHOLD,	// max #objects scanned exactly
+		bool  hugepage = false);		// arena on huge pages?
 
 	// -------------------------------------------------------------------------
 	~ML_RQALSH();					// destructor
@@ -35,6 +41,35 @@ public:
 		const float *query,				// input query
 		MaxK_List *list);				// top-k results (return)
 
+	// -------------------------------------------------------------------------
+	int kfn(						// c-k-AFN search with budget and deadline
+		int   top_k,					// top-k value
+		int   budget,					// candidate budget (0: per block)
+		double deadline,				// deadline by get_cur_time() (0: none)
+		const float *query,				// input query
+		MaxK_List *list,				// top-k results (return)
+		bool  &finished);				// terminated normally? (return)
+
+	// -------------------------------------------------------------------------
+	void kfn_group(					// interleaved c-k-AFN search of queries
+		int   top_k,					// top-k value
+		int   num,						// number of queries
+		const float **query,			// input queries
+		MaxK_List **list,				// top-k results (return)
+		int   *check);					// number of checked objects (return)
+
+#ifdef RQALSH_STATS
+	// -------------------------------------------------------------------------
+	void display_stats(				// display search statistics per block
+		FILE *fp);						// output file
+#endif
+
+	// -------------------------------------------------------------------------
+	inline int get_num_builds()		// get number of block builds so far
+	{
+		return num_builds_;
+	}
+
 	// -------------------------------------------------------------------------
 	int64_t get_memory_usage()		// get memory usage
 	{
@@ -43,8 +78,17 @@ public:
 		ret += SIZEFLOAT * dim_; 	// centroid_
 		ret += SIZEINT * n_pts_;	// sorted_id_
 		ret += SIZEFLOAT * radius_.capacity(); // radius_
+		ret += SIZEFLOAT * block_r_.capacity(); // block_r_
+		ret += SIZEFLOAT * dim_ * radius_.size(); // block_ctr_
+		ret += SIZEINT * block_start_.capacity(); // block_start_
+		ret += sizeof(int64_t) * last_use_.capacity(); // last_use_
+		ret += sizeof(int64_t) * use_cnt_.capacity(); // use_cnt_
+		if (bank_ != NULL) ret += bank_->get_memory_usage(); // bank_
+		if (arena_ != NULL) {		// arena_ (unused tail, blocks are below)
+			ret += arena_->get_memory_usage() - arena_->get_used();
+		}
 		for (auto lsh : lsh_) {		// blocks_
-			ret += lsh->get_memory_usage();
+			if (lsh != NULL) ret += lsh->get_memory_usage();
 		}
 		return ret;
 	}
@@ -54,9 +98,56 @@ protected:
 	int   dim_;						// dimensionality
 	float ratio_;					// approximation ratio
 	const float *data_;				// data objects
+	int   proj_;					// projection family
+	int   n_thres_;					// max #objects scanned exactly
 
 	int   *sorted_id_;				// sorted data id after ml-partition
 	float *centroid_;				// centroid of data objects
 	std::vector<float> radius_;		// radius
 	std::vector<RQALSH*> lsh_;		// blocks
+	Projection *bank_;				// hash functions shared by the blocks
+	Arena *arena_;					// owner of the blocks (or NULL)
+	int   bank_m_;					// number of hash functions in bank_
+
+	float *block_ctr_;				// centroid of each block
+	std::vector<float> block_r_;	// radius of each block to its centroid
+	std::vector<int> block_start_;	// start position of each block
+	bool  adaptive_;				// partition by cost model?
+
+	int   max_blocks_;				// max #blocks kept (0: build all)
+	int   num_built_;				// number of blocks built now
+	int   num_builds_;				// number of block builds so far
+	int64_t tick_;					// access counter
+	std::vector<int64_t> last_use_;	// last access of each block
+	std::vector<int64_t> use_cnt_;	// number of accesses of each block
+
+	// -------------------------------------------------------------------------
+	void partition_by_lambda(		// partition by LAMBDA
+		const Result *arr);				// objects sorted by l2-dist to centroid
+
+	// -------------------------------------------------------------------------
+	double calc_block_cost(			// calc expected cost of one block visit
+		int   n);						// number of objects in the block
+
+	// -------------------------------------------------------------------------
+	void partition_by_cost(			// partition by cost model
+		const Result *arr);				// objects sorted by l2-dist to centroid
+
+	// -------------------------------------------------------------------------
+	void build_block(				// build rqalsh for a block
+		int   i);						// block id
+
+	// -------------------------------------------------------------------------
+	RQALSH* get_block(				// get the rqalsh of a block
+		int   i);						// block id
+
+	// -------------------------------------------------------------------------
+	float* project(					// project query by bank_ (once)
+		const float *query,				// input query
+		float *q_val);					// hash values so far (NULL: not yet)
+
+	// -------------------------------------------------------------------------
+	void get_order(					// get the visiting order of blocks
+		const float *query,				// input query
+		Result *order);					// blocks with upper bound (return)
 };
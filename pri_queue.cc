@@ -77,3 +77,79 @@ float MaxK_List::insert(			// insert item
 
 	return min_key();
 }
+
+// -----------------------------------------------------------------------------
+Head_Heap::Head_Heap(				// constructor (given max size)
+	int max)							// max size
+{
+	num_  = 0;
+	k_    = max;
+	heap_ = new Result[max];
+}
+
+// -----------------------------------------------------------------------------
+Head_Heap::~Head_Heap()				// destructor
+{
+	if (heap_ != NULL) {
+		delete[] heap_; heap_ = NULL;
+	}
+}
+
+// -----------------------------------------------------------------------------
+void Head_Heap::push(				// insert the head of a list
+	float key,							// key of head
+	int   id)							// list id
+{
+	heap_[num_].key_ = key;
+	heap_[num_].id_  = id;
+	sift_up(num_++);
+}
+
+// -----------------------------------------------------------------------------
+void Head_Heap::pop()				// remove the top head
+{
+	if (--num_ > 0) {
+		heap_[0] = heap_[num_];
+		sift_down(0);
+	}
+}
+
+// -----------------------------------------------------------------------------
+void Head_Heap::replace_top(		// replace the top head by a new one
+	float key,							// key of new head
+	int   id)							// list id
+{
+	heap_[0].key_ = key;
+	heap_[0].id_  = id;
+	sift_down(0);
+}
+
+// -----------------------------------------------------------------------------
+void Head_Heap::sift_up(			// move item at pos up
+	int pos)							// position
+{
+	Result item = heap_[pos];
+	while (pos > 0) {
+		int parent = (pos - 1) >> 1;
+		if (!before(item, heap_[parent])) break;
+		heap_[pos] = heap_[parent];
+		pos = parent;
+	}
+	heap_[pos] = item;
+}
+
+// -----------------------------------------------------------------------------
+void Head_Heap::sift_down(			// move item at pos down
+	int pos)							// position
+{
+	Result item = heap_[pos];
+	while (true) {
+		int child = 2 * pos + 1;
+		if (child >= num_) break;
+		if (child + 1 < num_ && before(heap_[child+1], heap_[child])) ++child;
+		if (!before(heap_[child], item)) break;
+		heap_[pos] = heap_[child];
+		pos = child;
+	}
+	heap_[pos] = item;
+}
@@ -64,3 +64,60 @@ private:
 	int    num_;					// number of key current active
 	Result *list_;					// the list itself
 };
+
+// -----------------------------------------------------------------------------
+//  Head_Heap: an indexed max-heap over the heads of a set of lists. Each list 
+//  has at most one entry (its current head) in the heap, keyed by its score. 
+//  Ties are broken by the smaller list id, so the top is the same one a linear 
+//  scan over all heads would pick. Advancing the head of the top list costs 
+//  O(log L) by replace_top().
+// -----------------------------------------------------------------------------
+class Head_Heap {
+public:
+	Head_Heap(int max);				// constructor (given max size)
+	~Head_Heap();					// destructor
+
+	// -------------------------------------------------------------------------
+	inline void reset() { num_ = 0; }
+
+	// -------------------------------------------------------------------------
+	inline int size() { return num_; }
+
+	// -------------------------------------------------------------------------
+	inline bool empty() { return num_ == 0; }
+
+	// -------------------------------------------------------------------------
+	inline float top_key() { return num_ > 0 ? heap_[0].key_ : MINREAL; }
+
+	// -------------------------------------------------------------------------
+	inline int top_id() { return num_ > 0 ? heap_[0].id_ : MININT; }
+
+	// -------------------------------------------------------------------------
+	void push(						// insert the head of a list
+		float key,						// key of head
+		int   id);						// list id
+
+	// -------------------------------------------------------------------------
+	void pop();						// remove the top head
+
+	// -------------------------------------------------------------------------
+	void replace_top(				// replace the top head by a new one
+		float key,						// key of new head
+		int   id);						// list id
+
+private:
+	int    k_;						// max number of heads
+	int    num_;					// number of heads current active
+	Result *heap_;					// the heap itself
+
+	// -------------------------------------------------------------------------
+	inline bool before(const Result &a, const Result &b) {
+		return a.key_ > b.key_ || (a.key_ == b.key_ && a.id_ < b.id_);
+	}
+
+	// -------------------------------------------------------------------------
+	void sift_up(int pos);			// move item at pos up
+
+	// -------------------------------------------------------------------------
+	void sift_down(int pos);		// move item at pos down
+};
@@ -0,0 +1,143 @@
+#include "proj.h"
+
+// -----------------------------------------------------------------------------
+static void fwht(					// in-place Walsh-Hadamard transform
+	int   p,							// length (power of 2)
+	float *x)							// vector (return)
+{
+	// the first two stages are merged, as their inner loops are too short 
+	// to be vectorized; the later ones run over contiguous halves
+	int h = 1;
+	if (p >= 4) {
+		for (int i = 0; i < p; i += 4) {
+			float a = x[i] + x[i+1], b = x[i] - x[i+1];
+			float c = x[i+2] + x[i+3], d = x[i+2] - x[i+3];
+			x[i] = a + c; x[i+1] = b + d; x[i+2] = a - c; x[i+3] = b - d;
+		}
+		h = 4;
+	}
+	for (; h < p; h <<= 1) {
+		for (int i = 0; i < p; i += h << 1) {
+			for (int j = i; j < i + h; ++j) {
+				float a = x[j], b = x[j+h];
+				x[j] = a + b; x[j+h] = a - b;
+			}
+		}
+	}
+}
+
+// -----------------------------------------------------------------------------
+Projection::Projection(				// constructor
+	int   m,							// number of projections
+	int   d,							// dimensionality
+	int   type,							// projection family (PROJ_DENSE, ...)
+	float sigma,						// standard deviation of the entries
+	Random_Gen &rng)					// random generator
+	: m_(m), d_(d), type_(type), a_(NULL), inner_prod_(NULL), s_(0), 
+	idx_(NULL), val_(NULL), p_(0), nb_(0), sign_(NULL), scale_(NULL)
+{
+	if (type == PROJ_SPARSE) {
+		// ---------------------------------------------------------------------
+		//  s distinct columns of each row by partial Fisher-Yates shuffle, 
+		//  sorted so that a point is read forwards
+		// ---------------------------------------------------------------------
+		s_ = MIN(d, (int) ceil(sqrt((float) d)));
+		idx_ = new int[m * s_];
+		val_ = new float[m * s_];
+
+		float v = sigma * sqrt((float) d / s_);
+		int   *col = new int[d];
+		for (int j = 0; j < d; ++j) col[j] = j;
+		for (int i = 0; i < m; ++i) {
+			for (int k = 0; k < s_; ++k) {
+				int r = k + (int) (rng.next() % (uint64_t) (d - k));
+				std::swap(col[k], col[r]);
+			}
+			std::sort(col, col + s_);
+			for (int k = 0; k < s_; ++k) {
+				idx_[i*s_+k] = col[k];
+				val_[i*s_+k] = (rng.next() >> 63) ? v : -v;
+			}
+		}
+		delete[] col;
+	}
+	else if (type == PROJ_HADAMARD) {
+		// ---------------------------------------------------------------------
+		//  the rows of (H D)^3 are orthogonal with norm p^{3/2}; S rescales 
+		//  them to the norms of Gaussian(0, sigma) rows, which follow sigma * 
+		//  chi(p), approximated by Gaussian(sqrt(p - 1/2), sqrt(1/2))
+		// ---------------------------------------------------------------------
+		p_ = 1; while (p_ < d) p_ <<= 1;
+		nb_ = (m + p_ - 1) / p_;
+		sign_  = new float[3 * nb_ * p_];
+		scale_ = new float[nb_ * p_];
+
+		float norm = p_ * sqrt((float) p_);
+		for (int k = 0; k < 3 * nb_ * p_; ++k) {
+			sign_[k] = (rng.next() >> 63) ? 1.0f : -1.0f;
+		}
+		for (int k = 0; k < nb_ * p_; ++k) {
+			float chi = rng.gaussian(sqrt(p_ - 0.5f), sqrt(0.5f));
+			scale_[k] = sigma * MAX(chi, 0.0f) / norm;
+		}
+	}
+	else {
+		type_ = PROJ_DENSE;
+		a_ = new float[m * d];
+		rng.gaussian(m * d, 0.0f, sigma, a_);
+		inner_prod_ = get_inner_product_func(d);
+	}
+}
+
+// -----------------------------------------------------------------------------
+Projection::~Projection()			// destructor
+{
+	if (a_     != NULL) { delete[] a_;     a_     = NULL; }
+	if (idx_   != NULL) { delete[] idx_;   idx_   = NULL; }
+	if (val_   != NULL) { delete[] val_;   val_   = NULL; }
+	if (sign_  != NULL) { delete[] sign_;  sign_  = NULL; }
+	if (scale_ != NULL) { delete[] scale_; scale_ = NULL; }
+}
+
+// -----------------------------------------------------------------------------
+void Projection::project(			// project a point by the first m projections
+	int   m,							// number of projections (<= m_)
+	const float *x,						// input point
+	float *y) const						// projected values (return)
+{
+	if (type_ == PROJ_DENSE) {
+		for (int i = 0; i < m; ++i) y[i] = inner_prod_(d_, &a_[i*d_], x);
+	}
+	else if (type_ == PROJ_SPARSE) {
+		for (int i = 0; i < m; ++i) {
+			const int   *idx = &idx_[i*s_];
+			const float *val = &val_[i*s_];
+			float ret = 0.0f;
+			for (int k = 0; k < s_; ++k) ret += val[k] * x[idx[k]];
+			y[i] = ret;
+		}
+	}
+	else {
+		// one block of the transform, in a per-thread buffer that is kept 
+		// across calls, so that projecting a point does not allocate
+		static thread_local std::vector<float> scratch;
+		if ((int) scratch.size() < p_) scratch.resize(p_);
+
+		float *t = scratch.data();
+		for (int b = 0; b * p_ < m; ++b) {
+			const float *sign  = &sign_[3*b*p_];
+			const float *scale = &scale_[b*p_];
+
+			for (int k = 0; k < d_; ++k) t[k] = sign[k] * x[k];
+			for (int k = d_; k < p_; ++k) t[k] = 0.0f;
+			fwht(p_, t);
+			for (int k = 0; k < p_; ++k) t[k] *= sign[p_+k];
+			fwht(p_, t);
+			for (int k = 0; k < p_; ++k) t[k] *= sign[2*p_+k];
+			fwht(p_, t);
+
+			int num = MIN(p_, m - b * p_);
+			for (int k = 0; k < num; ++k) y[b*p_+k] = scale[k] * t[k];
+		}
+	}
+}
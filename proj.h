@@ -0,0 +1,94 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <stdint.h>
+
+#include "def.h"
+#include "util.h"
+#include "random.h"
+
+// -----------------------------------------------------------------------------
+//  Projection: m random projections of d-dimensional points, whose entries
+//  follow (or approximate) Gaussian(0, sigma). The family is one of
+//
+//  PROJ_DENSE:    a dense m x d Gaussian matrix, O(m * d) per point
+//
+//  PROJ_SPARSE:   very sparse random projections (Li et al., KDD 2006): each
+//                 row has s = ceil(sqrt(d)) non-zeros of +-sigma*sqrt(d/s),
+//                 O(m * s) per point
+//
+//  PROJ_HADAMARD: structured orthogonal random features (Yu et al., NIPS
+//                 2016): the point is padded to P = 2^k >= d dimensions, and
+//                 each block of P projections is S H D3 H D2 H D1, where H is
+//                 the Walsh-Hadamard transform, D1-D3 random sign flips, and
+//                 S a diagonal that scales the rows to the norms of Gaussian
+//                 rows, O(m log d) per point
+//
+//  The structured families only approximate independent Gaussian rows, so
+//  their recall should be checked against PROJ_DENSE (the rows in a block of
+//  PROJ_HADAMARD are orthogonal, which was no worse in our tests; Fastfood,
+//  S H G Pi H B, lost recall).
+// -----------------------------------------------------------------------------
+class Projection {
+public:
+	Projection(						// constructor
+		int   m,						// number of projections
+		int   d,						// dimensionality
+		int   type,						// projection family (PROJ_DENSE, ...)
+		float sigma,					// standard deviation of the entries
+		Random_Gen &rng);				// random generator
+
+	// -------------------------------------------------------------------------
+	~Projection();					// destructor
+
+	// -------------------------------------------------------------------------
+	void project(					// project a point by the first m projections
+		int   m,						// number of projections (<= m_)
+		const float *x,					// input point
+		float *y) const;				// projected values (return)
+
+	// -------------------------------------------------------------------------
+	inline void project(			// project a point by all m projections
+		const float *x,					// input point
+		float *y) const					// projected values (return)
+	{
+		project(m_, x, y);
+	}
+
+	// -------------------------------------------------------------------------
+	int64_t get_memory_usage() const // get memory usage
+	{
+		int64_t ret = 0;
+		ret += sizeof(*this);
+		if (a_    != NULL) ret += SIZEFLOAT * m_ * d_; // a_
+		if (idx_  != NULL) ret += (SIZEINT + SIZEFLOAT) * m_ * s_; // idx_, val_
+		if (sign_ != NULL) ret += 4 * SIZEFLOAT * nb_ * p_; // sign_, scale_
+		return ret;
+	}
+
+	// -------------------------------------------------------------------------
+	inline int get_type() const { return type_; }
+
+	// -------------------------------------------------------------------------
+	inline int get_num() const { return m_; }
+
+protected:
+	int   m_;						// number of projections
+	int   d_;						// dimensionality
+	int   type_;					// projection family
+
+	float *a_;						// dense matrix (m * d)
+	Dist_Func inner_prod_;			// calc_inner_product() for d
+
+	int   s_;						// number of non-zeros per row
+	int   *idx_;					// column of non-zeros (m * s)
+	float *val_;					// value  of non-zeros (m * s)
+
+	int   p_;						// padded dimensionality (2^k >= d)
+	int   nb_;						// number of blocks (nb * p >= m)
+	float *sign_;					// D1, D2, D3: random signs (3 * nb * p)
+	float *scale_;					// S: row scaling (nb * p)
+};
@@ -1,133 +1,5 @@
 #include "qdafn.h"
 
-// -----------------------------------------------------------------------------
-//  Ziggurat Method standard normal pseudorandom number generator code from 
-//  George Marsaglia and Wai Wan Tsang (2000).
-// 
-//  "The Ziggurat Method for Generating Random Variables". Journal of
-//  Statistical Software 5 (8).
-// -----------------------------------------------------------------------------
-long hz;
-unsigned long jsr = 123456789;
-unsigned long jz;
-unsigned long iz, kn[128], ke[256];
-float wn[128],fn[128], we[256],fe[256];
-
-// -----------------------------------------------------------------------------
-//  nfix() generates variates from the residue when rejection in RNOR occurs
-// -----------------------------------------------------------------------------
-float nfix()
-{
-	const float r = 3.442620;		// The start of the right tail
-	static float x, y;
-
-	while (1) {
-		x = hz * wn[iz];
-		if (iz == 0) {				// iz == 0, handles the base strip
-			do {
-				x = -log(UNI)*0.2904764;
-				y = -log(UNI);
-			} while (y+y < x*x);
-
-			return (hz>0) ? (r+x) : (-r-x);
-		}
-									// iz > 0, handle the wedges of other strips
-		if (fn[iz] + UNI*(fn[iz-1]-fn[iz]) < exp(-0.5*x*x)) {
-			return x;
-		}
-
-		hz = SHR3;					// initiate, try to exit loop
-		iz = hz & 127;
-		if (abs(hz) < kn[iz]) return hz*wn[iz];
-	}
-}
-
-// -----------------------------------------------------------------------------
-//  efix() generates variates from the residue when rejection in REXP occurs
-// -----------------------------------------------------------------------------
-float efix()
-{
-	float x = -1.0f;
-	while (1) {
-		if (iz == 0) {
-			return 7.69711-log(UNI);// iz == 0
-		}
-
-		x = jz * we[iz];
-		if (fe[iz] + UNI*(fe[iz-1]-fe[iz]) < exp(-x)) {
-			return x;
-		}
-
-		jz = SHR3;					// initiate, try to exit loop
-		iz = (jz & 255);
-		if (jz < ke[iz]) return jz*we[iz];
-	}
-}
-
-// -----------------------------------------------------------------------------
-//  this procedure sets the seed and creates the tables
-// -----------------------------------------------------------------------------
-void zigset(						// set the seed and create the tables
-	unsigned long jsrseed)				// new seed
-{
-	const double m1 = 2147483648.0;
-	const double m2 = 4294967296.0;
-
-	double dn = 3.442619855899;
-	double tn = dn;
-	double vn = 9.91256303526217e-3;
-	double q;
-
-	double de = 7.697117470131487;
-	double te = de;
-	double ve = 3.949659822581572e-3;
-	int i;
-
-	jsr^=jsrseed;
-
-	// -------------------------------------------------------------------------
-	//  set up tables for RNOR
-	// -------------------------------------------------------------------------
-	q = vn / exp(-0.5 * dn * dn);
-	kn[0] = (dn / q) * m1;
-	kn[1] = 0;
-
-	wn[0] = q / m1;
-	wn[127] = dn / m1;
-
-	fn[0] = 1.0;
-	fn[127] = exp(-0.5 * dn * dn);
-
-	for (i = 126; i >= 1; i--) {
-		dn = sqrt(-2.0 * log(vn / dn + exp(-0.5 * dn * dn)));
-		kn[i+1] = (dn / tn) * m1;
-		tn = dn;
-		fn[i] = exp(-0.5 * dn * dn);
-		wn[i] = dn / m1;
-	}
-
-	// -------------------------------------------------------------------------
-	//  set up tables for REXP
-	// -------------------------------------------------------------------------
-	q = ve / exp(-de);
-	ke[0] = (de / q) * m2;
-	ke[1] = 0;
-
-	we[0] = q / m2;
-	we[255] = de / m2;
-
-	fe[0] = 1.0;
-	fe[255] = exp(-de);
-
-	for (i = 254; i >= 1; i--) {
-		de = -log(ve / de + exp(-de));
-		ke[i+1] = (de / te) * m2;
-		te = de;
-		fe[i] = exp(-de);
-		we[i] = de / m2;
-	}
-}
-
 // -----------------------------------------------------------------------------
 static int PDISTComp(               // compare func for quick (ascending)   
 	const void *xv,                     // 1st element
@@ -190,8 +62,39 @@ QDAFN::QDAFN(						// constructor
 	int   M,							// number of candidates
     int   algo,							// which algorithm
 	float ratio,						// approximation ratio
-	const float *data)			       	// data objects
-	: n_pts_(n), dim_(d), L_(L), M_(M), algo_(algo), ratio_(ratio), data_(data) 
+	const float *data,			       	// data objects
+	int   seed,							// random seed
+	int   proj)							// projection family
+	: n_pts_(n), dim_(d), L_(L), M_(M), algo_(algo), ratio_(ratio), data_(data), 
+	l2_dist_(get_l2_dist_func(d))
+{
+	init(seed, proj);
+	bulkload();
+}
+
+// -----------------------------------------------------------------------------
+QDAFN::QDAFN(						// constructor (streaming)
+	int   n,							// number of data objects
+	int   d,							// number of dimensions
+	int   L,							// number of projections
+	int   M,							// number of candidates
+    int   algo,							// which algorithm
+	float ratio,						// approximation ratio
+	const char *fname,					// address of data objects
+	float *data,						// data objects (return)
+	int   seed,							// random seed
+	int   proj)							// projection family
+	: n_pts_(n), dim_(d), L_(L), M_(M), algo_(algo), ratio_(ratio), data_(data), 
+	l2_dist_(get_l2_dist_func(d))
+{
+	init(seed, proj);
+	if (bulkload(fname, data)) exit(1);
+}
+
+// -----------------------------------------------------------------------------
+void QDAFN::init(					// init parameters and projections
+	int   seed,							// random seed
+	int   proj)							// projection family
 {
 	// calc parameters 
 	if (L_ == 0 || M_ == 0) {
@@ -209,115 +112,224 @@ QDAFN::QDAFN(						// constructor
 		}
 	}
 	// generate hash functions
-	zigset(MAGIC + 17); 			// zigset(MAGIC + time(NULL));
+	Random_Gen rng(seed);
 
-	proj_ = new float[L_ * dim_]; 
-	for (int i = 0; i < L_ * dim_; ++i) {
-		proj_[i] = RNOR / sqrt((float) dim_);
-	}
-	// build index
-	bulkload();
+	proj_ = new Projection(L_, dim_, proj, 1.0f / sqrt((float) dim_), rng);
+}
+
+// -----------------------------------------------------------------------------
+//  Ascending order for <pdist>, if tie, ascending order for <obj>
+// -----------------------------------------------------------------------------
+static bool PDISTLess(				// compare func for std::sort (ascending)
+	const PDIST_PAIR &x,				// 1st element
+	const PDIST_PAIR &y)				// 2nd element
+{
+	if (x.u.pdist < y.u.pdist) return true;
+	if (x.u.pdist > y.u.pdist) return false;
+	return x.obj < y.obj;
 }
 
 // -----------------------------------------------------------------------------
 int QDAFN::bulkload()				// build index
 {
+	TRACE_SCOPE("bulkload", n_pts_);
+	pdp_ = new PDIST_PAIR[(L_ + 1) * n_pts_];
+	proj_time_ = sort_time_ = merge_time_ = 0.0f;
+
+	project_rows(0, n_pts_);
+	sort_rows(0, n_pts_);
+	return rank_rows();
+}
+
+// -----------------------------------------------------------------------------
+//  streaming build: the data objects are read from <fname> into <data> chunk 
+//  by chunk, and each chunk is projected and sorted into one run of every 
+//  projection while the next chunks are read; adjacent runs are merged on the 
+//  fly, so the index equals that of bulkload()
+// -----------------------------------------------------------------------------
+int QDAFN::bulkload(				// build index (streaming)
+	const char *fname,					// address of data objects
+	float *data)						// data objects (return)
+{
+	TRACE_SCOPE("bulkload", n_pts_);
+	pdp_ = new PDIST_PAIR[(L_ + 1) * n_pts_];
+	proj_time_ = sort_time_ = merge_time_ = 0.0f;
+
+	std::vector<int> runs(1, 0);
+	int ret = stream_bin_data(n_pts_, dim_, STREAM_CHUNK, fname, data, 
+		[&](int s, int e) {
+			project_rows(s, e);
+			sort_rows(s, e);
+			add_sorted_run(e, e == n_pts_, runs, [&](int lo, int mid, int hi) {
+				merge_rows(lo, mid, hi);
+			});
+		});
+	if (ret) return ret;
+	return rank_rows();
+}
+
+// -----------------------------------------------------------------------------
+void QDAFN::project_rows(			// project data objects [s, e)
+	int   s,							// start object id
+	int   e)							// end   object id
+{
+	TRACE_SCOPE("project", e - s);
+	timeval start_time, end_time;
+
 	// -------------------------------------------------------------------------
-	//  project all the points
+	//  project the points: each data object is projected by all L 
+	//  projections at once, so it stays in cache (and the structured 
+	//  projections transform it only once per block of projections)
 	// -------------------------------------------------------------------------
-	pdp_ = new PDIST_PAIR[(L_ + 1) * n_pts_];
+	gettimeofday(&start_time, NULL);
+	#pragma omp parallel
+	{
+		float *val = new float[L_];
+		#pragma omp for schedule(dynamic, PROJ_BLOCK)
+		for (int j = s; j < e; ++j) {
+			proj_->project(&data_[j * dim_], val);
+			for (int i = 0; i < L_; ++i) {
+				pdp_[(i + 1) * n_pts_ + j].obj     = j + 1;
+				pdp_[(i + 1) * n_pts_ + j].u.pdist = val[i];
+			}
+		}
+		delete[] val;
+	}
+	gettimeofday(&end_time, NULL);
+	proj_time_ += end_time.tv_sec - start_time.tv_sec + 
+		(end_time.tv_usec - start_time.tv_usec) / 1000000.0f;
 
-	for (int i = 0; i < L_; ++i) {
-		for (int j = 0;j < n_pts_; ++j) {
-			float x = 0.0f;
-			for (int k = 0; k < dim_; ++k) {
-				x += proj_[i * dim_ + k] * data_[j * dim_ + k];
+	// -------------------------------------------------------------------------
+	//  find most extreme projected value for each point (by projected value)
+	// 
+	//  the projections are still in the order of object id, so each point 
+	//  is reduced independently before sorting
+	// -------------------------------------------------------------------------
+	gettimeofday(&start_time, NULL);
+	if (algo_ != 1) {
+		#pragma omp parallel for
+		for (int j = s; j < e; ++j) {
+			float min_pdist = 1.0e38;
+			for (int i = 1; i <= L_; ++i) {
+				float pdist = pdp_[i*n_pts_+j].u.pdist;
+				if (pdist < min_pdist) min_pdist = pdist;
 			}
-			pdp_[(i+1) * n_pts_ + j].obj     = j + 1;
-			pdp_[(i+1) * n_pts_ + j].u.pdist = x;
+			pdp_[j].obj     = j + 1;
+			pdp_[j].u.pdist = min_pdist;
 		}
 	}
+	gettimeofday(&end_time, NULL);
+	merge_time_ += end_time.tv_sec - start_time.tv_sec + 
+		(end_time.tv_usec - start_time.tv_usec) / 1000000.0f;
+}
+
+// -----------------------------------------------------------------------------
+void QDAFN::sort_rows(				// sort objects [s, e) within projections
+	int   s,							// start object id
+	int   e)							// end   object id
+{
+	TRACE_SCOPE("sort", e - s);
+	timeval start_time, end_time;
+
+	gettimeofday(&start_time, NULL);
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 1; i <= L_; ++i) {
+		std::sort(pdp_ + i*n_pts_ + s, pdp_ + i*n_pts_ + e, PDISTLess);
+	}
+	gettimeofday(&end_time, NULL);
+	sort_time_ += end_time.tv_sec - start_time.tv_sec + 
+		(end_time.tv_usec - start_time.tv_usec) / 1000000.0f;
+}
+
+// -----------------------------------------------------------------------------
+void QDAFN::merge_rows(				// merge sorted runs within projections
+	int   lo,							// start of 1st run
+	int   mid,							// start of 2nd run
+	int   hi)							// end   of 2nd run
+{
+	TRACE_SCOPE("merge", hi - lo);
+	timeval start_time, end_time;
+
+	gettimeofday(&start_time, NULL);
+	#pragma omp parallel for schedule(dynamic)
+	for (int i = 1; i <= L_; ++i) {
+		PDIST_PAIR *pdp = pdp_ + i*n_pts_;
+		std::inplace_merge(pdp + lo, pdp + mid, pdp + hi, PDISTLess);
+	}
+	gettimeofday(&end_time, NULL);
+	sort_time_ += end_time.tv_sec - start_time.tv_sec + 
+		(end_time.tv_usec - start_time.tv_usec) / 1000000.0f;
+}
+
+// -----------------------------------------------------------------------------
+int QDAFN::rank_rows()				// compute master ranks
+{
+	TRACE_SCOPE("rank", n_pts_);
+	timeval start_time, end_time;
 
 	// -------------------------------------------------------------------------
 	//  compute master ranks
 	// -------------------------------------------------------------------------
+	gettimeofday(&start_time, NULL);
 	if (algo_ == 1) {
 		// ---------------------------------------------------------------------
 		//  based on ranks and times achieved
 		// 
-		//  1. sort within each projection
+		//  1. find most extreme rank number for each point: the object ids 
+		//  are split into disjoint ranges, and the thread of a range scans 
+		//  all projections but updates only its range of the summary pdp_[0, n)
 		// ---------------------------------------------------------------------
-		for (int i = 1; i <= L_; ++i) {
-			qsort(pdp_+i*n_pts_, n_pts_, sizeof(PDIST_PAIR), PDISTComp);
-		}
+		int num_ranges = get_num_threads();
+
+		#pragma omp parallel for schedule(static)
+		for (int r = 0; r < num_ranges; ++r) {
+			int lo = (int) ((int64_t) n_pts_ * r / num_ranges) + 1;
+			int hi = (int) ((int64_t) n_pts_ * (r + 1) / num_ranges) + 1;
+			for (int j = lo - 1; j < hi - 1; ++j) {
+				pdp_[j].obj = j + 1;
+				pdp_[j].u.rta.rank = n_pts_;
+				pdp_[j].u.rta.times_achieved = 0;
+			}
 
-		// ---------------------------------------------------------------------
-		//  2. assign rank numbers
-		// ---------------------------------------------------------------------
-		for (int i = 1; i <= L_; ++i) {
-			for (int j = 0; j < n_pts_; ++j) {
-				pdp_[i*n_pts_+j].u.rta.rank = j;
+			for (int i = 1; i <= L_; ++i) {
+				const PDIST_PAIR *pdp = &pdp_[i * n_pts_];
+				for (int j = 0; j < n_pts_; ++j) {
+					int obj = pdp[j].obj;
+					if (obj < lo || obj >= hi) continue;
+
+					RTA &item = pdp_[obj - 1].u.rta;
+					if (j < item.rank) {
+						item.rank = j;
+						item.times_achieved = 1;
+					}
+					else if (j == item.rank) {
+						item.times_achieved++;
+					}
+				}
 			}
 		}
 
 		// ---------------------------------------------------------------------
-		//  3. find most extreme rank number for each point
+		//  2. assign rank numbers and sort on those
 		// ---------------------------------------------------------------------
-		for (int j = 0; j < n_pts_; ++j) {
-			pdp_[j].obj = j + 1;
-			pdp_[j].u.rta.rank = n_pts_;
-			pdp_[j].u.rta.times_achieved = 0;
-		}
-
+		#pragma omp parallel for
 		for (int i = 1; i <= L_; ++i) {
 			for (int j = 0; j < n_pts_; ++j) {
-				if (pdp_[i*n_pts_+j].u.rta.rank < pdp_[pdp_[i*n_pts_+j].obj-1].u.rta.rank) {
-					pdp_[pdp_[i*n_pts_+j].obj-1].u.rta.rank = pdp_[i*n_pts_+j].u.rta.rank;
-					pdp_[pdp_[i*n_pts_+j].obj-1].u.rta.times_achieved = 1;
-				}
-				else if (pdp_[i*n_pts_+j].u.rta.rank == pdp_[pdp_[i*n_pts_+j].obj-1].u.rta.rank) {
-					pdp_[pdp_[i*n_pts_+j].obj-1].u.rta.times_achieved++;
-				}
+				pdp_[i*n_pts_+j].u.rta.rank = j;
 			}
 		}
-
-		// ---------------------------------------------------------------------
-		//  4. sort on those
-		// ---------------------------------------------------------------------
 		qsort(pdp_, n_pts_, sizeof(PDIST_PAIR), RTAComp);
 	}
 	else {
 		// ---------------------------------------------------------------------
-		//  based on projected value
-		// ---------------------------------------------------------------------
-
-		// ---------------------------------------------------------------------
-		//  1. sort within each projection (extra)
-		// ---------------------------------------------------------------------
-		for (int i = 1; i <= L_; ++i) {
-			qsort(pdp_ + i * n_pts_, n_pts_, sizeof(PDIST_PAIR), PDISTComp);
-		}
-
-		// ---------------------------------------------------------------------
-		//  2. find most extreme projected value for each point
-		// ---------------------------------------------------------------------
-		for (int j = 0; j < n_pts_; ++j) {
-			pdp_[j].obj = j + 1;
-			pdp_[j].u.pdist = 1.0e38;
-		}
-		for (int i = 1; i <= L_; ++i) {
-			for (int j = 0; j < n_pts_; ++j) {
-				if (pdp_[i*n_pts_+j].u.pdist < pdp_[pdp_[i*n_pts_+j].obj-1].u.pdist) {
-					pdp_[pdp_[i*n_pts_+j].obj-1].u.pdist = pdp_[i*n_pts_+j].u.pdist;
-				}
-			}
-		}
-
-		// ---------------------------------------------------------------------
-		//  3. sort on those
+		//  based on projected value: sort on those
 		// ---------------------------------------------------------------------
 		qsort(pdp_, n_pts_, sizeof(PDIST_PAIR), PDISTComp);
 	}
+	gettimeofday(&end_time, NULL);
+	merge_time_ += end_time.tv_sec - start_time.tv_sec + 
+		(end_time.tv_usec - start_time.tv_usec) / 1000000.0f;
+
 	return 0;
 }
 
@@ -325,7 +337,7 @@ int QDAFN::bulkload()				// build index
 QDAFN::~QDAFN()						// destrcutor
 {
 	delete[] pdp_;  pdp_  = NULL; 
-	delete[] proj_; proj_ = NULL; 
+	delete   proj_; proj_ = NULL; 
 }
 
 // -----------------------------------------------------------------------------
@@ -338,6 +350,11 @@ void QDAFN::display() 				// display parameters
 	printf("    M    = %d\n",   M_);
 	printf("    c    = %.1f\n", ratio_);
 	printf("    algo = %s\n\n", algoname[algo_]);
+
+	printf("Bulkload of QDAFN:\n");
+	printf("    project = %f Seconds\n",   proj_time_);
+	printf("    sort    = %f Seconds\n",   sort_time_);
+	printf("    merge   = %f Seconds\n\n", merge_time_);
 }
 
 // -----------------------------------------------------------------------------
@@ -357,41 +374,39 @@ int QDAFN::kfn(						// c-k-AFN search
 		int   *next    = new int[L_]; 
 		float *proj_q  = new float[L_];
 		bool  *checked = new bool[n_pts_];
+		Head_Heap *heap = new Head_Heap(L_);
 
 		memset(checked, false, n_pts_ * SIZEBOOL);
 
+		proj_->project(query, proj_q);
 		for (int i = 0; i < L_; ++i) {
 			next[i] = 0;
-			float x = 0.0f;
-			for (int j = 0; j < dim_; ++j) {
-				x += proj_[i*dim_+j] * query[j];
-			}
-			proj_q[i] = x;
+			heap->push(fabs(pdp_[n_pts_*(i+1)].u.pdist - proj_q[i]), i);
 		}
 
-		for (int i = 0; i < candidates; ++i) {
-			int   found_next = pdp_[n_pts_ + next[0]].obj;
-			float y = fabs(pdp_[n_pts_+next[0]].u.pdist - proj_q[0]);
-			int   found_in_proj = 0;
+		// ---------------------------------------------------------------------
+		//  the heap keeps the head of each projection, so the projection with 
+		//  the largest |proj_dist - proj_q| is found in O(log L)
+		// ---------------------------------------------------------------------
+		for (int i = 0; i < candidates && !heap->empty(); ++i) {
+			int j = heap->top_id();
+			int found_next = pdp_[n_pts_*(j+1)+next[j]].obj;
 
-			for (int j = 1; j < L_; ++j) {
+			if (++next[j] < n_pts_) {
 				float z = fabs(pdp_[n_pts_*(j+1)+next[j]].u.pdist - proj_q[j]);
-				if (z > y) {
-					y = z;
-					found_next = pdp_[n_pts_*(j+1)+next[j]].obj;
-					found_in_proj = j;
-				}
+				heap->replace_top(z, j);
 			}
-			next[found_in_proj]++;
+			else heap->pop();
 
 			int id = found_next - 1;
 			if (!checked[id]) {
-				float dist = calc_l2_dist(dim_, query, &data_[id*dim_]);
+				float dist = l2_dist_(dim_, query, &data_[id*dim_]);
 				list->insert(dist, id + 1);
 				checked[id] = true;
 				cnt++;
 			}
 		}
+		delete heap;
 		delete[] proj_q;  proj_q = NULL;
 		delete[] next;    next = NULL;
 		delete[] checked; checked = NULL;
@@ -402,7 +417,7 @@ int QDAFN::kfn(						// c-k-AFN search
 		// ---------------------------------------------------------------------
 		for (int i = 0; i < candidates; ++i) {
 			int   id   = pdp_[i].obj;
-			float dist = calc_l2_dist(dim_, query, &data_[(id-1)*dim_]);
+			float dist = l2_dist_(dim_, query, &data_[(id-1)*dim_]);
 			list->insert(dist, id);
 			cnt++;
 		}
@@ -7,35 +7,14 @@
 
 #include "def.h"
 #include "util.h"
+#include "random.h"
+#include "proj.h"
 #include "pri_queue.h"
 
 class MaxK_List;
 
-// -----------------------------------------------------------------------------
-//  Ziggurat Method standard normal pseudorandom number generator code from 
-//  George Marsaglia and Wai Wan Tsang (2000).
-// 
-//  "The Ziggurat Method for Generating Random Variables". Journal of
-//  Statistical Software 5 (8).
-// -----------------------------------------------------------------------------
-extern long hz;
-extern unsigned long jz,jsr;
-extern unsigned long iz, kn[128], ke[256];
-extern float wn[128],fn[128], we[256],fe[256];
-
 static char *algoname[3] = { "By Value", "By Rank", "Query Dependent" };
 
-#define SHR3 (jz=jsr, jsr^=(jsr<<13), jsr^=(jsr>>17), jsr^=(jsr<<5), jz+jsr)
-#define UNI  (0.5 + (signed) SHR3 * 0.2328306e-9)
-#define IUNI SHR3
-#define RNOR (hz=SHR3, iz=hz&127, (abs(hz)<kn[iz])? hz*wn[iz] : nfix())
-#define REXP (jz=SHR3, iz=jz&255, (jz <ke[iz])? jz*we[iz] : efix())
-
-// -----------------------------------------------------------------------------
-float nfix();
-float efix();
-void  zigset(unsigned long jsrseed);
-
 // -----------------------------------------------------------------------------
 //  data structure for QDAFN
 // -----------------------------------------------------------------------------
@@ -80,7 +59,22 @@ public:
         int   M,						// number of candidates
         int   algo,						// which algorithm
         float ratio,					// approximation ratio
-        const float *data);				// data objects
+        const float *data,				// data objects
+        int   seed,						// random seed
+        int   proj = PROJ_DENSE);		// projection family
+
+    // -------------------------------------------------------------------------
+    QDAFN(                          // constructor (streaming)
+        int   n,						// cardinality
+        int   d,						// dimensionality
+        int   L,						// number of projections
+        int   M,						// number of candidates
+        int   algo,						// which algorithm
+        float ratio,					// approximation ratio
+        const char *fname,				// address of data objects
+        float *data,					// data objects (return)
+        int   seed,						// random seed
+        int   proj = PROJ_DENSE);		// projection family
     
     // -------------------------------------------------------------------------
     ~QDAFN();                       // destructor
@@ -94,12 +88,15 @@ public:
 	    const float *query,				// input query
 	    MaxK_List *list);				// c-k-AFN results (return)
 
+	// -------------------------------------------------------------------------
+	inline void set_M(int M) { M_ = M; } // reset #candidates without rebuild
+
 	// -------------------------------------------------------------------------
 	int64_t get_memory_usage()		// get memory usage
 	{
 		int64_t ret = 0;
 		ret += sizeof(*this);
-		ret += SIZEFLOAT * L_ * dim_; // proj_
+		ret += proj_->get_memory_usage(); // proj_
 		ret += sizeof(PDIST_PAIR) * (L_ + 1) * n_pts_; // pdp_
 		return ret;
 	}
@@ -112,10 +109,44 @@ protected:
 	int   algo_;	    	    	// which algorithm
     float ratio_;					// approximation ratio
     const float *data_;				// data objects
+	Dist_Func l2_dist_;				// calc_l2_dist() for dim_
 
-    float *proj_;			        // projection vectors
+    Projection *proj_;		        // projection vectors
 	PDIST_PAIR *pdp_;				// projected info after random projection
 
+	float proj_time_;				// bulkload time of projection (seconds)
+	float sort_time_;				// bulkload time of sorting (seconds)
+	float merge_time_;				// bulkload time of master ranks (seconds)
+
+	// -------------------------------------------------------------------------
+	void init(						// init parameters and projections
+		int   seed,						// random seed
+		int   proj);					// projection family
+
 	// -------------------------------------------------------------------------
     int bulkload();                 // build index    
+
+	// -------------------------------------------------------------------------
+	int bulkload(					// build index (streaming)
+		const char *fname,				// address of data objects
+		float *data);					// data objects (return)
+
+	// -------------------------------------------------------------------------
+	void project_rows(				// project data objects [s, e)
+		int   s,						// start object id
+		int   e);						// end   object id
+
+	// -------------------------------------------------------------------------
+	void sort_rows(					// sort objects [s, e) within projections
+		int   s,						// start object id
+		int   e);						// end   object id
+
+	// -------------------------------------------------------------------------
+	void merge_rows(				// merge sorted runs within projections
+		int   lo,						// start of 1st run
+		int   mid,						// start of 2nd run
+		int   hi);						// end   of 2nd run
+
+	// -------------------------------------------------------------------------
+	int rank_rows();				// compute master ranks
 };
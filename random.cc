@@ -20,6 +20,64 @@ float gaussian(						// r.v. from N(mean, sigma)
 	// return mu + sigma * sqrt(-2.0f * log(u1)) * sin(2.0f * PI * u2);
 }
 
+// -----------------------------------------------------------------------------
+Random_Gen::Random_Gen(				// constructor
+	uint64_t seed)						// random seed
+{
+	// use splitmix64 to expand the seed into the state of xoshiro256**
+	for (int i = 0; i < 4; ++i) {
+		uint64_t z = (seed += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		s_[i] = z ^ (z >> 31);
+	}
+}
+
+// -----------------------------------------------------------------------------
+float Random_Gen::gaussian(			// r.v. from Gaussian(mean, sigma)
+	float mu,							// mean (location)
+	float sigma)						// stanard deviation (scale > 0)
+{
+	float u1 = open_uniform();
+	float u2 = uniform(0.0f, 1.0f);
+
+	return mu + sigma * sqrt(-2.0f * log(u1)) * cos(2.0f * PI * u2);
+}
+
+// -----------------------------------------------------------------------------
+//  generate n r.v. by Box-Muller transform in batches: the uniform r.v. are 
+//  drawn first, and then transformed by a loop without dependency, so that 
+//  the compiler can vectorize it; both cos and sin of a pair are used
+// -----------------------------------------------------------------------------
+void Random_Gen::gaussian(			// n r.v. from Gaussian(mean, sigma)
+	int   n,							// number of r.v.
+	float mu,							// mean (location)
+	float sigma,						// stanard deviation (scale > 0)
+	float *x)							// r.v. (return)
+{
+	const int BATCH = 256;
+	float u1[BATCH], u2[BATCH];
+
+	int i = 0;
+	while (i + 1 < n) {
+		int size = MIN(BATCH, (n - i) / 2);
+		for (int j = 0; j < size; ++j) {
+			u1[j] = open_uniform();
+			u2[j] = uniform(0.0f, 2.0f * PI);
+		}
+
+		float *y = &x[i];
+		#pragma omp simd
+		for (int j = 0; j < size; ++j) {
+			float r = sigma * sqrtf(-2.0f * logf(u1[j]));
+			y[2*j]   = mu + r * cosf(u2[j]);
+			y[2*j+1] = mu + r * sinf(u2[j]);
+		}
+		i += 2 * size;
+	}
+	if (i < n) x[i] = gaussian(mu, sigma);
+}
+
 // -----------------------------------------------------------------------------
 float gaussian_cdf(					// cdf of N(0, 1) in range (-inf, x]
 	float x,							// integral border
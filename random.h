@@ -3,6 +3,7 @@
 #include <iostream>
 #include <algorithm>
 #include <cmath>
+#include <stdint.h>
 
 #include "def.h"
 
@@ -26,6 +27,67 @@ float gaussian(						// r.v. from Gaussian(mean, sigma)
 	float mu,							// mean (location)
 	float sigma);						// stanard deviation (scale > 0)
 
+// -----------------------------------------------------------------------------
+//  Random_Gen: a seedable pseudorandom number generator owned by its user. It 
+//  is based on xoshiro256** from David Blackman and Sebastiano Vigna (2018), 
+//  "Scrambled Linear Pseudorandom Number Generators". 
+//
+//  Different from rand(), there is no global state, so several indexes can be 
+//  built concurrently, and each of them is reproducible given its seed.
+// -----------------------------------------------------------------------------
+class Random_Gen {
+public:
+	Random_Gen(						// constructor
+		uint64_t seed);					// random seed
+
+	// -------------------------------------------------------------------------
+	inline uint64_t next()			// next 64-bit random integer
+	{
+		const uint64_t ret = rotl(s_[1] * 5, 7) * 9;
+		const uint64_t t = s_[1] << 17;
+
+		s_[2] ^= s_[0]; s_[3] ^= s_[1];
+		s_[1] ^= s_[2]; s_[0] ^= s_[3];
+		s_[2] ^= t;     s_[3] = rotl(s_[3], 45);
+
+		return ret;
+	}
+
+	// -------------------------------------------------------------------------
+	inline float uniform(			// r.v. from Uniform[min, max)
+		float min,						// min value
+		float max)						// max value
+	{
+		return min + (max - min) * ((next() >> 40) * (1.0f / 16777216.0f));
+	}
+
+	// -------------------------------------------------------------------------
+	float gaussian(					// r.v. from Gaussian(mean, sigma)
+		float mu,						// mean (location)
+		float sigma);					// stanard deviation (scale > 0)
+
+	// -------------------------------------------------------------------------
+	void gaussian(					// n r.v. from Gaussian(mean, sigma)
+		int   n,						// number of r.v.
+		float mu,						// mean (location)
+		float sigma,					// stanard deviation (scale > 0)
+		float *x);						// r.v. (return)
+
+private:
+	uint64_t s_[4];					// state of generator
+
+	// -------------------------------------------------------------------------
+	static inline uint64_t rotl(const uint64_t x, int k) {
+		return (x << k) | (x >> (64 - k));
+	}
+
+	// -------------------------------------------------------------------------
+	inline float open_uniform()		// r.v. from Uniform(0, 1]
+	{
+		return ((next() >> 40) + 1) * (1.0f / 16777216.0f);
+	}
+};
+
 // -----------------------------------------------------------------------------
 //  functions used for calculating probability distribution function (pdf) and 
 //  cumulative distribution function (cdf)
@@ -1,81 +1,306 @@
 #include "rqalsh.h"
 
+// -----------------------------------------------------------------------------
+void add_stats(						// accumulate search statistics
+	const Search_Stats &src,			// source statistics
+	Search_Stats &dst)					// target statistics (return)
+{
+	dst.queries_     += src.queries_;
+	dst.rounds_      += src.rounds_;
+	dst.tables_      += src.tables_;
+	dst.scanned_     += src.scanned_;
+	dst.max_scanned_ = MAX(dst.max_scanned_, src.max_scanned_);
+	dst.verified_    += src.verified_;
+	dst.proj_time_   += src.proj_time_;
+	dst.scan_time_   += src.scan_time_;
+	dst.verify_time_ += src.verify_time_;
+}
+
+// -----------------------------------------------------------------------------
+void display_stats_header(			// display header of search statistics
+	FILE  *fp)							// output file
+{
+	fprintf(fp, "Block\tn\tm\tQueries\tRounds\tScanned/Table\tMaxScanned\t"
+		"Verified\tProj (ms)\tScan (ms)\tVerify (ms)\n");
+}
+
+// -----------------------------------------------------------------------------
+void display_stats(					// display one row of search statistics
+	FILE  *fp,							// output file
+	int   bid,							// block id (-1: total)
+	int   n,							// cardinality
+	int   m,							// number of hash tables
+	const Search_Stats &stats)			// search statistics
+{
+	// counters are averaged over the queries that visited the index
+	double qn = (double) MAX(stats.queries_, 1);
+	double tn = (double) MAX(stats.tables_,  1);
+
+	if (bid < 0) fprintf(fp, "total\t");
+	else fprintf(fp, "%d\t", bid);
+	fprintf(fp, "%d\t%d\t%lld\t%.2f\t%.2f\t%lld\t%.2f\t%.4f\t%.4f\t%.4f\n", 
+		n, m, (long long) stats.queries_, stats.rounds_ / qn, 
+		stats.scanned_ / tn, (long long) stats.max_scanned_, 
+		stats.verified_ / qn, stats.proj_time_ / qn, stats.scan_time_ / qn, 
+		stats.verify_time_ / qn);
+}
+
+// -----------------------------------------------------------------------------
+static inline float calc_l2_prob(	// calc <p1> and <p2> for L2 distance
+	float x)							// x = w / (2.0 * r)
+{
+	return 1.0f - new_gaussian_prob(x);
+}
+
+// -----------------------------------------------------------------------------
+void calc_rqalsh_params(			// calc bucket width, #tables and threshold
+	int   n,							// cardinality
+	float ratio,						// approximation ratio
+	float &w,							// bucket width (return)
+	int   &m,							// number of hash tables (return)
+	int   &l)							// collision threshold (return)
+{
+	w = sqrt((8.0f * log(ratio)) / (ratio * ratio - 1.0f));
+	
+	float p1 = calc_l2_prob(w / 2.0f);
+	float p2 = calc_l2_prob(w * ratio / 2.0f);
+
+	float beta  = (float) CANDIDATES / (float) n;
+	float delta = 0.49f;
+
+	float para1 = sqrt(log(2.0f / beta));
+	float para2 = sqrt(log(1.0f / delta));
+	float para3 = 2.0f * (p1 - p2) * (p1 - p2);
+
+	float eta   = para1 / para2;
+	float alpha = (eta * p1 + p2) / (1.0f + eta);
+
+	m = (int) ceil((para1 + para2) * (para1 + para2) / para3);
+	l = (int) ceil(alpha * m);
+}
+
+// -----------------------------------------------------------------------------
+//  calibrate n_thres of RQALSH by a microbenchmark on random data: the exact scan 
+//  (over packed data objects) and the rqalsh search are timed for doubling 
+//  sizes, and the threshold is the largest size where the exact scan is not 
+//  slower. The scan grows linearly with n while rqalsh grows sublinearly, so 
+//  it stops at the first size where rqalsh wins. It is at least CANDIDATES + 
+//  MAXK, below which rqalsh would verify (almost) all objects anyway.
+// -----------------------------------------------------------------------------
+int calibrate_n_threshold(			// calibrate max #objects scanned exactly
+	int   d,							// dimensionality
+	float ratio,						// approximation ratio
+	int   proj)							// projection family
+{
+	const int NUM_SIZE  = 8;			// number of sizes
+	const int NUM_QUERY = 50;			// number of queries for each size
+	const int NUM_RUN   = 3;			// best of NUM_RUN runs
+
+	int min_n = CANDIDATES + MAXK;
+	int max_n = min_n << (NUM_SIZE - 1);
+
+	Random_Gen rng(MAGIC);
+	float *data  = new float[(int64_t) max_n * d];
+	float *query = new float[NUM_QUERY * d];
+	rng.gaussian(max_n * d, 0.0f, 1.0f, data);
+	rng.gaussian(NUM_QUERY * d, 0.0f, 1.0f, query);
+	MaxK_List *list = new MaxK_List(MAXK);
+
+	int ret = min_n;
+	for (int s = 1; s < NUM_SIZE; ++s) {
+		int    n = min_n << s;
+		double t[2];					// time of exact scan and rqalsh
+
+		for (int mode = 0; mode < 2; ++mode) {
+			RQALSH *lsh = new RQALSH(n, d, ratio, NULL, data, mode == 0, MAGIC, 
+				proj, NULL, NULL, mode == 0 ? n : 0);
+
+			t[mode] = MAXREAL;
+			for (int r = 0; r < NUM_RUN; ++r) {
+				double start = get_cur_time();
+				for (int i = 0; i < NUM_QUERY; ++i) {
+					list->reset();
+					lsh->kfn(MAXK, MINREAL, &query[i*d], list);
+				}
+				t[mode] = MIN(t[mode], get_cur_time() - start);
+			}
+			delete lsh;
+		}
+		if (t[0] > t[1]) break;
+		ret = n;
+	}
+
+	delete[] data;
+	delete[] query;
+	delete list;
+	return ret;
+}
+
 // -----------------------------------------------------------------------------
 RQALSH::RQALSH(						// constructor
 	int   n,							// cardinality
 	int   d,							// dimensionality
 	float ratio,						// approximation ratio
 	const int *index,					// index of data objects
-	const float *data)					// data objects
-	: n_pts_(n), dim_(d), ratio_(ratio), index_(index), data_(data)
+	const float *data,					// data objects
+	bool  packed,						// pack data objects contiguously?
+	int   seed,							// random seed
+	int   proj,							// projection family (if not bank)
+	const Projection *bank,				// shared hash functions (NULL: own)
+	Arena *arena,						// owner of tables (NULL: heap)
+	int   n_thres)						// max #objects scanned exactly
+	: n_pts_(n), dim_(d), ratio_(ratio), index_(index), data_(data), 
+	packed_data_(NULL), pf_dist_(0), l2_dist_(get_l2_dist_func(d)), 
+	l2_dist_batch_(get_l2_dist_batch_func(d)), own_proj_(false), arena_(arena)
 {
-	if (n <= N_THRESHOLD) {
-		w_      = 0.0f;
-		m_      = 0;
-		l_      = 0;
-		proj_a_ = NULL;
-		tables_ = NULL;
+	// the counters of small blocks stay in cache, where prefetch only adds 
+	// instructions to the scan
+	if (n > PREFETCH_N) pf_dist_ = PREFETCH_DIST;
+
+	// the indexed data objects are copied into one buffer, so verification 
+	// streams over it instead of gathering rows by index
+	if (packed) {
+		float *dst = NULL;
+		if (arena_ != NULL) dst = arena_->alloc_array<float>((int64_t) n * d);
+		packed_data_ = pack_data(n, d, index, data, dst);
 	}
-	else {
-		// auto tuning w and determine m and l
-		w_  = sqrt((8.0f * log(ratio_)) / (ratio_ * ratio_ - 1.0f));
-		
-		float p1 = calc_l2_prob(w_ / 2.0f);
-		float p2 = calc_l2_prob(w_ * ratio_ / 2.0f);
-
-		float beta  = (float) CANDIDATES / (float) n_pts_;
-		float delta = 0.49f;
-
-		float para1 = sqrt(log(2.0f / beta));
-		float para2 = sqrt(log(1.0f / delta));
-		float para3 = 2.0f * (p1 - p2) * (p1 - p2);
-
-		float eta   = para1 / para2;
-		float alpha = (eta * p1 + p2) / (1.0f + eta);
-
-		m_ = (int) ceil((para1 + para2) * (para1 + para2) / para3);
-		l_ = (int) ceil(alpha * m_);
-
-		// generate hash functions
-		proj_a_ = new float[m_ * d];
-		for (int i = 0; i < m_ * d; ++i) proj_a_[i] = gaussian(0.0f, 1.0f);
-		
-		// build hash tables
-		int id = -1;
-		tables_ = new Result[m_ * n];
-		for (int i = 0; i < m_; ++i) {
-			for (int j = 0; j < n; ++j) {
-				if (index_) id = index_[j];
-				else id = j;
+	STATS(reset_stats());
 
-				tables_[i*n+j].id_  = j;
-				tables_[i*n+j].key_ = calc_hash_value(i, &data_[id*d]);
-			}
+	init_hash(seed, proj, bank, n_thres);
+	if (m_ > 0) {
+		hash_rows(0, n);
+
+		TRACE_SCOPE("sort tables", n);
+		#pragma omp parallel for schedule(dynamic)
+		for (int i = 0; i < m_; ++i) {
 			qsort(&tables_[i*n], n, sizeof(Result), ResultComp);
 		}
 	}
 }
 
-// -------------------------------------------------------------------------
-inline float RQALSH::calc_l2_prob(	// calc <p1> and <p2> for L2 distance
-	float x)							// x = w / (2.0 * r)
+// -----------------------------------------------------------------------------
+static bool ResultLess(				// compare func for std::sort (ascending)
+	const Result &x,					// 1st element
+	const Result &y)					// 2nd element
 {
-	return 1.0f - new_gaussian_prob(x);
+	if (x.key_ < y.key_) return true;
+	if (x.key_ > y.key_) return false;
+	return x.id_ < y.id_;
 }
 
-// -------------------------------------------------------------------------
-float RQALSH::calc_hash_value( 		// calc hash value
-	int   tid,							// hash table id
-	const float *data)					// one data object
+// -----------------------------------------------------------------------------
+//  streaming constructor: the data objects are read from <fname> into <data> 
+//  chunk by chunk, and each chunk is hashed and sorted into one run of every 
+//  hash table while the next chunks are read; adjacent runs are merged on the 
+//  fly, so the tables equal those of the constructor above
+// -----------------------------------------------------------------------------
+RQALSH::RQALSH(						// constructor (streaming)
+	int   n,							// cardinality
+	int   d,							// dimensionality
+	float ratio,						// approximation ratio
+	const char *fname,					// address of data objects
+	float *data,						// data objects (return)
+	int   seed,							// random seed
+	int   proj,							// projection family
+	int   n_thres)						// max #objects scanned exactly
+	: n_pts_(n), dim_(d), ratio_(ratio), index_(NULL), data_(data), 
+	packed_data_(NULL), pf_dist_(0), l2_dist_(get_l2_dist_func(d)), 
+	l2_dist_batch_(get_l2_dist_batch_func(d)), own_proj_(false), arena_(NULL)
+{
+	if (n > PREFETCH_N) pf_dist_ = PREFETCH_DIST;
+	STATS(reset_stats());
+
+	init_hash(seed, proj, NULL, n_thres);
+	std::vector<int> runs(1, 0);
+	int ret = stream_bin_data(n, d, STREAM_CHUNK, fname, data, 
+		[&](int s, int e) {
+			if (m_ == 0) return;
+			hash_rows(s, e);
+			{
+				TRACE_SCOPE("sort tables", e - s);
+				#pragma omp parallel for schedule(dynamic)
+				for (int i = 0; i < m_; ++i) {
+					std::sort(&tables_[i*n+s], &tables_[i*n+e], ResultLess);
+				}
+			}
+			add_sorted_run(e, e == n, runs, [&](int lo, int mid, int hi) {
+				TRACE_SCOPE("merge tables", hi - lo);
+				#pragma omp parallel for schedule(dynamic)
+				for (int i = 0; i < m_; ++i) {
+					std::inplace_merge(&tables_[i*n+lo], &tables_[i*n+mid], 
+						&tables_[i*n+hi], ResultLess);
+				}
+			});
+		});
+	if (ret) exit(1);
+}
+
+// -----------------------------------------------------------------------------
+void RQALSH::init_hash(				// init parameters and hash functions
+	int   seed,							// random seed
+	int   proj,							// projection family (if not bank)
+	const Projection *bank,				// shared hash functions (NULL: own)
+	int   n_thres)						// max #objects scanned exactly
+{
+	if (n_pts_ <= n_thres) {
+		w_      = 0.0f;
+		m_      = 0;
+		l_      = 0;
+		proj_   = NULL;
+		tables_ = NULL;
+		return;
+	}
+	// auto tuning w and determine m and l
+	calc_rqalsh_params(n_pts_, ratio_, w_, m_, l_);
+
+	// generate hash functions, or use the first m_ ones of a shared bank
+	if (bank != NULL) {
+		assert(bank->get_num() >= m_);
+		proj_ = bank;
+	}
+	else {
+		Random_Gen rng(seed);
+		proj_ = new Projection(m_, dim_, proj, 1.0f, rng);
+		own_proj_ = true;
+	}
+	if (arena_ != NULL) tables_ = arena_->alloc_array<Result>(m_ * n_pts_);
+	else tables_ = new Result[m_ * n_pts_];
+}
+
+// -----------------------------------------------------------------------------
+void RQALSH::hash_rows(				// hash data objects [s, e) into tables
+	int   s,							// start local id
+	int   e)							// end   local id
 {
-	return calc_inner_product(dim_, &proj_a_[tid*dim_], data);
+	// each object is projected by all hash functions at once, which the 
+	// structured projections need
+	TRACE_SCOPE("hash", e - s);
+	int n = n_pts_;
+	#pragma omp parallel
+	{
+		float *val = new float[m_];
+		#pragma omp for
+		for (int j = s; j < e; ++j) {
+			proj_->project(m_, get_data(j), val);
+			for (int i = 0; i < m_; ++i) {
+				tables_[i*n+j].id_  = j;
+				tables_[i*n+j].key_ = val[i];
+			}
+		}
+		delete[] val;
+	}
 }
 
 // -----------------------------------------------------------------------------
 RQALSH::~RQALSH()					// destructor
 {
-	if (proj_a_ != NULL) { delete[] proj_a_; proj_a_ = NULL; }
-	if (tables_ != NULL) { delete[] tables_; tables_ = NULL; }
+	if (own_proj_) { delete proj_; }
+	proj_ = NULL;
+	if (arena_ == NULL) {			// otherwise released with the arena
+		if (tables_ != NULL) delete[] tables_;
+		if (packed_data_ != NULL) delete_aligned_floats(packed_data_);
+	}
+	tables_ = NULL; packed_data_ = NULL;
 }
 
 // -------------------------------------------------------------------------
@@ -95,19 +320,63 @@ int RQALSH::kfn(					// k-FN search (for ML_RQALSH)
 	int   top_k,						// top-k value
 	float R,							// limited search range
 	const float *query,					// input query
-	MaxK_List *list)					// c-k-AFN results (return)
+	MaxK_List *list,					// c-k-AFN results (return)
+	const float *q_val)					// hash values by the bank (NULL: calc)
+{
+	bool finished = true;
+	return kfn(top_k, R, 0, 0.0, query, list, finished, q_val);
+}
+
+// -----------------------------------------------------------------------------
+//  anytime k-FN search: it stops once <budget> candidates are verified or the 
+//  deadline has passed, and <list> keeps the best-so-far results
+// -----------------------------------------------------------------------------
+int RQALSH::kfn(					// k-FN search with budget and deadline
+	int   top_k,						// top-k value
+	float R,							// limited search range
+	int   budget,						// candidate budget (0: CANDIDATES+k-1)
+	double deadline,					// deadline by get_cur_time() (0: none)
+	const float *query,					// input query
+	MaxK_List *list,					// c-k-AFN results (return)
+	bool  &finished,					// terminated normally? (return)
+	const float *q_proj)				// hash values by the bank (NULL: calc)
 {
-	if (n_pts_ <= N_THRESHOLD) {
+	STATS(++stats_.queries_);
+	STATS(double start_time = get_cur_time());
+
+	if (m_ == 0) {						// small block: exact scan
+		int n = n_pts_;
+		if (budget > 0 && budget < n) n = budget;
+		finished = (n == n_pts_);
+
+		STATS(stats_.verified_ += n);
+		if (packed_data_ != NULL) {
+			// streaming batch distance over the packed data objects
+			float dist[BATCH_SIZE];
+			for (int i = 0; i < n; i += BATCH_SIZE) {
+				int num = MIN(BATCH_SIZE, n - i);
+				l2_dist_batch_(num, dim_, query, get_data(i), dist);
+				for (int j = 0; j < num; ++j) {
+					if (dist[j] > list->min_key()) {
+						list->insert(dist[j], get_id(i+j) + 1);
+					}
+				}
+			}
+			STATS(stats_.verify_time_ += get_cur_time() - start_time);
+			return n;
+		}
+
 		int   id   = -1;
 		float dist = -1.0f;
-		for (int i = 0; i < n_pts_; ++i) {
+		for (int i = 0; i < n; ++i) {
 			if (index_) id = index_[i];
 			else id = i;
 
-			dist = calc_l2_dist(dim_, query, &data_[id*dim_]);
+			dist = l2_dist_(dim_, query, &data_[id*dim_]);
 			list->insert(dist, id + 1);
 		}
-		return n_pts_;
+		STATS(stats_.verify_time_ += get_cur_time() - start_time);
+		return n;
 	}
 
 	// -------------------------------------------------------------------------
@@ -120,14 +389,18 @@ int RQALSH::kfn(					// k-FN search (for ML_RQALSH)
 	bool  *b_flag  = new bool[m_];		// bucket flag
 	bool  *r_flag  = new bool[m_];		// range  flag
 	float *q_val   = new float[m_];		// hash value of query
+	STATS(int *t_scan = new int[m_]);	// entries scanned in each table
+	STATS(memset(t_scan, 0, m_ * SIZEINT));
+	STATS(double verify_time = 0.0);
 
 	memset(freq,    0,     n_pts_ * SIZEFLOAT);
 	memset(checked, false, n_pts_ * SIZEBOOL);
 	memset(b_flag,  true,  m_     * SIZEBOOL);
 	memset(r_flag,  true,  m_     * SIZEBOOL);
 
+	if (q_proj != NULL) memcpy(q_val, q_proj, m_ * SIZEFLOAT);
+	else proj_->project(m_, query, q_val);
 	for (int i = 0; i < m_; ++i) {
-		q_val[i] = calc_hash_value(i, query);
 		l_pos[i] = 0;  
 		r_pos[i] = n_pts_ - 1;
 	}
@@ -137,12 +410,22 @@ int RQALSH::kfn(					// k-FN search (for ML_RQALSH)
 	// -------------------------------------------------------------------------
 	int   cand      = CANDIDATES + top_k - 1; // candidate size
 	int   cand_cnt  = 0;			// candidate counter
+	bool  timeout   = false;		// has the deadline passed?
 	int   num_range = 0; 			// number of search range flag
 	float radius    = find_radius(l_pos, r_pos, q_val); 	// search radius
 	float width     = radius * w_ / 2.0f; 					// bucket width
 	float range     = R < CHECK_ERROR ? 0.0f : R*w_/2.0f; 	// search range
+	int   pf        = pf_dist_;		// prefetch distance
+	if (budget > 0) cand = budget;
+
+	// the scan is a short lookahead pipeline: the counter of the entry pf 
+	// slots ahead is prefetched, and the data object whose counter is one 
+	// below threshold l is prefetched before it becomes a candidate
+	STATS(double scan_time = get_cur_time());
+	STATS(stats_.proj_time_ += scan_time - start_time);
 
 	while (true) {
+		STATS(++stats_.rounds_);
 		// ---------------------------------------------------------------------
 		//  step 1: initialization
 		// ---------------------------------------------------------------------
@@ -167,24 +450,32 @@ int RQALSH::kfn(					// k-FN search (for ML_RQALSH)
 				// -------------------------------------------------------------
 				cnt = 0;
 				lpos = l_pos[j]; rpos = r_pos[j];
+				for (int k = 0; k < pf && lpos + k < rpos; ++k) {
+					__builtin_prefetch(&freq[table[lpos+k].id_], 1);
+				}
 				while (cnt < SCAN_SIZE) {
 					ldist = MINREAL;
 					if (lpos < rpos) ldist = fabs(q_v - table[lpos].key_);
 					else break;
 					if (ldist < width || ldist < range) break;
 
+					if (pf > 0 && cnt + pf < SCAN_SIZE && lpos + pf < rpos) {
+						__builtin_prefetch(&freq[table[lpos+pf].id_], 1);
+					}
 					int id = table[lpos].id_;
-					if (++freq[id] >= l_ && !checked[id]) {
+					if (++freq[id] == l_ - 1 && pf > 0) {
+						prefetch_data(get_data(id), dim_ * SIZEFLOAT);
+					}
+					else if (freq[id] >= l_ && !checked[id]) {
 						checked[id] = true;
 
-						int did = id;
-						if (index_ != NULL) did = index_[id];
-						// printf("did = %d\n", did);
-						float dist = calc_l2_dist(dim_, query, &data_[did*dim_]);
-						list->insert(dist, did + 1);
+						STATS(double t = get_cur_time());
+						float dist = l2_dist_(dim_, query, get_data(id));
+						list->insert(dist, get_id(id) + 1);
+						STATS(verify_time += get_cur_time() - t);
 						if (++cand_cnt >= cand) break;
 					}
-					++lpos; ++cnt;
+					++lpos; ++cnt; STATS(++t_scan[j]);
 				}
 				if (cand_cnt >= cand) break;
 				l_pos[j] = lpos;
@@ -193,24 +484,32 @@ int RQALSH::kfn(					// k-FN search (for ML_RQALSH)
 				//  step 2.2: scan right part of hash table
 				// -------------------------------------------------------------
 				cnt = 0;
+				for (int k = 0; k < pf && rpos - k > lpos; ++k) {
+					__builtin_prefetch(&freq[table[rpos-k].id_], 1);
+				}
 				while (cnt < SCAN_SIZE) {
 					rdist = MINREAL;
 					if (lpos < rpos) rdist = fabs(q_v - table[rpos].key_);
 					else break;
 					if (rdist < width || rdist < range) break;
 
+					if (pf > 0 && cnt + pf < SCAN_SIZE && rpos - pf > lpos) {
+						__builtin_prefetch(&freq[table[rpos-pf].id_], 1);
+					}
 					int id = table[rpos].id_;
-					if (++freq[id] >= l_ && !checked[id]) {
+					if (++freq[id] == l_ - 1 && pf > 0) {
+						prefetch_data(get_data(id), dim_ * SIZEFLOAT);
+					}
+					else if (freq[id] >= l_ && !checked[id]) {
 						checked[id] = true;
 						
-						int did = id;
-						if (index_ != NULL) did = index_[id];
-						// printf("did = %d\n", did);
-						float dist = calc_l2_dist(dim_, query, &data_[did*dim_]);
-						list->insert(dist, did + 1);
+						STATS(double t = get_cur_time());
+						float dist = l2_dist_(dim_, query, get_data(id));
+						list->insert(dist, get_id(id) + 1);
+						STATS(verify_time += get_cur_time() - t);
 						if (++cand_cnt >= cand) break;
 					}
-					--rpos; ++cnt;
+					--rpos; ++cnt; STATS(++t_scan[j]);
 				}
 				if (cand_cnt >= cand) break;
 				r_pos[j] = rpos;
@@ -225,6 +524,11 @@ int RQALSH::kfn(					// k-FN search (for ML_RQALSH)
 					if (b_flag[j]) { b_flag[j] = false; ++num_bucket; }
 					if (r_flag[j]) { r_flag[j] = false; ++num_range;  }
 				}
+				// the deadline is checked once per table: the search stops 
+				// as if the candidate budget is used up
+				if (deadline > 0.0 && get_cur_time() > deadline) {
+					timeout = true; cand = cand_cnt; break;
+				}
 				// use break after checking both b_flag and r_flag
 				if (num_bucket >= m_ || num_range >= m_) break;
 			}
@@ -242,6 +546,19 @@ int RQALSH::kfn(					// k-FN search (for ML_RQALSH)
 		radius = radius / ratio_;
 		width  = radius * w_ / 2.0f;
 	}
+#ifdef RQALSH_STATS
+	scan_time = get_cur_time() - scan_time;
+	stats_.tables_      += m_;
+	stats_.verified_    += cand_cnt;
+	stats_.verify_time_ += verify_time;
+	stats_.scan_time_   += scan_time - verify_time;
+	for (int i = 0; i < m_; ++i) {
+		stats_.scanned_ += t_scan[i];
+		if (t_scan[i] > stats_.max_scanned_) stats_.max_scanned_ = t_scan[i];
+	}
+	delete[] t_scan;
+#endif
+
 	// -------------------------------------------------------------------------
 	//  release space
 	// -------------------------------------------------------------------------
@@ -253,9 +570,241 @@ int RQALSH::kfn(					// k-FN search (for ML_RQALSH)
 	delete[] r_flag;
 	delete[] q_val;
 
+	finished = !timeout && (budget <= 0 || cand_cnt < cand);
 	return cand_cnt;
 }
 
+// -----------------------------------------------------------------------------
+//  c-k-AFN search of a group of queries interleaved on one core: each query 
+//  scans one hash table, prefetches the table positions of its next step and 
+//  the rows of its new candidates, and then yields to the next query, so the 
+//  cache misses of one query are overlapped with the work of the others. The 
+//  results are the same as kfn() for each query.
+// -----------------------------------------------------------------------------
+void RQALSH::kfn_group(				// interleaved c-k-AFN search of queries
+	int   top_k,						// top-k value
+	int   num,							// number of queries
+	const float *R,						// limited search range of each query
+	const float **query,				// input queries
+	MaxK_List **list,					// c-k-AFN results (return)
+	int   *check,						// number of checked objects (return)
+	const float **q_val)				// hash values by the bank (NULL: calc)
+{
+	if (m_ == 0) {						// small block: exact scan
+		for (int i = 0; i < num; ++i) {
+			check[i] = kfn(top_k, R[i], query[i], list[i]);
+		}
+		return;
+	}
+
+	KFN_State *s = new KFN_State[num];
+	for (int i = 0; i < num; ++i) {
+		init_state(top_k, R[i], query[i], list[i], 
+			q_val != NULL ? q_val[i] : NULL, s[i]);
+		prefetch_state(s[i]);
+	}
+
+	int active = num;
+	while (active > 0) {
+		for (int i = 0; i < num; ++i) {
+			if (s[i].done_) continue;
+
+			verify_state(s[i]);
+			step_state(s[i]);
+			if (s[i].done_) {
+				verify_state(s[i]);
+				check[i] = s[i].cand_cnt_;
+				release_state(s[i]);
+				--active;
+			}
+			else prefetch_state(s[i]);
+		}
+	}
+	delete[] s;
+}
+
+// -----------------------------------------------------------------------------
+void RQALSH::init_state(			// init the search state of one query
+	int   top_k,						// top-k value
+	float R,							// limited search range
+	const float *query,					// input query
+	MaxK_List *list,					// c-k-AFN results
+	const float *q_val,					// hash values by the bank (NULL: calc)
+	KFN_State &s)						// search state (return)
+{
+	s.query_   = query;
+	s.list_    = list;
+	s.freq_    = new unsigned short[n_pts_];
+	s.l_pos_   = new int[m_];
+	s.r_pos_   = new int[m_];
+	s.b_flag_  = new bool[m_];
+	s.r_flag_  = new bool[m_];
+	s.q_val_   = new float[m_];
+
+	memset(s.freq_,    0,     n_pts_ * sizeof(unsigned short));
+	memset(s.b_flag_,  true,  m_     * SIZEBOOL);
+	memset(s.r_flag_,  true,  m_     * SIZEBOOL);
+
+	if (q_val != NULL) memcpy(s.q_val_, q_val, m_ * SIZEFLOAT);
+	else proj_->project(m_, query, s.q_val_);
+	for (int i = 0; i < m_; ++i) {
+		s.l_pos_[i] = 0;  
+		s.r_pos_[i] = n_pts_ - 1;
+	}
+	s.cand_       = CANDIDATES + top_k - 1;
+	s.cand_cnt_   = 0;
+	s.num_bucket_ = 0;
+	s.num_range_  = 0;
+	s.tid_        = 0;
+	s.radius_     = find_radius(s.l_pos_, s.r_pos_, s.q_val_);
+	s.width_      = s.radius_ * w_ / 2.0f;
+	s.range_      = R < CHECK_ERROR ? 0.0f : R * w_ / 2.0f;
+	s.done_       = false;
+	s.num_pend_   = 0;
+
+	STATS(++stats_.queries_);
+	STATS(++stats_.rounds_);
+	STATS(stats_.tables_ += m_);
+}
+
+// -----------------------------------------------------------------------------
+//  one step of kfn(): the (R,c)-FN search of the next unfinished hash table 
+//  (step 2), followed by the stop condition (step 3) and the radius update 
+//  (step 4) once all hash tables are finished for this radius
+// -----------------------------------------------------------------------------
+void RQALSH::step_state(			// scan one hash table for one query
+	KFN_State &s)						// search state
+{
+	while (!s.b_flag_[s.tid_]) {
+		if (++s.tid_ == m_) s.tid_ = 0;
+	}
+	int    j   = s.tid_;
+	int    cnt = -1, lpos = -1, rpos = -1;
+	float  q_v = s.q_val_[j], ldist = -1.0f, rdist = -1.0f;
+	Result *table = &tables_[j * n_pts_];
+
+	// -------------------------------------------------------------------------
+	//  step 2.1: scan left part of hash table
+	// -------------------------------------------------------------------------
+	cnt = 0;
+	lpos = s.l_pos_[j]; rpos = s.r_pos_[j];
+	while (cnt < SCAN_SIZE) {
+		ldist = MINREAL;
+		if (lpos < rpos) ldist = fabs(q_v - table[lpos].key_);
+		else break;
+		if (ldist < s.width_ || ldist < s.range_) break;
+
+		int id = table[lpos].id_;
+		if (s.freq_[id] < l_ && ++s.freq_[id] == l_) {
+			s.pend_[s.num_pend_++] = id;
+			prefetch_data(get_data(id), dim_ * SIZEFLOAT);
+			if (++s.cand_cnt_ >= s.cand_) { s.done_ = true; return; }
+		}
+		++lpos; ++cnt; STATS(++stats_.scanned_);
+	}
+	s.l_pos_[j] = lpos;
+
+	// -------------------------------------------------------------------------
+	//  step 2.2: scan right part of hash table
+	// -------------------------------------------------------------------------
+	cnt = 0;
+	while (cnt < SCAN_SIZE) {
+		rdist = MINREAL;
+		if (lpos < rpos) rdist = fabs(q_v - table[rpos].key_);
+		else break;
+		if (rdist < s.width_ || rdist < s.range_) break;
+
+		int id = table[rpos].id_;
+		if (s.freq_[id] < l_ && ++s.freq_[id] == l_) {
+			s.pend_[s.num_pend_++] = id;
+			prefetch_data(get_data(id), dim_ * SIZEFLOAT);
+			if (++s.cand_cnt_ >= s.cand_) { s.done_ = true; return; }
+		}
+		--rpos; ++cnt; STATS(++stats_.scanned_);
+	}
+	s.r_pos_[j] = rpos;
+
+	// -------------------------------------------------------------------------
+	//  step 2.3: check whether this width is finished scanned
+	// -------------------------------------------------------------------------
+	if (lpos >= rpos || (ldist < s.width_ && rdist < s.width_)) {
+		if (s.b_flag_[j]) { s.b_flag_[j] = false; ++s.num_bucket_; }
+	}
+	if (lpos >= rpos || (ldist < s.range_ && rdist < s.range_)) {
+		if (s.b_flag_[j]) { s.b_flag_[j] = false; ++s.num_bucket_; }
+		if (s.r_flag_[j]) { s.r_flag_[j] = false; ++s.num_range_;  }
+	}
+	if (++s.tid_ == m_) s.tid_ = 0;
+	if (s.num_bucket_ < m_ && s.num_range_ < m_) return;
+
+	// -------------------------------------------------------------------------
+	//  step 3: stop condition
+	// -------------------------------------------------------------------------
+	if (s.num_range_ >= m_) { s.done_ = true; return; }
+
+	// -------------------------------------------------------------------------
+	//  step 4: update radius
+	// -------------------------------------------------------------------------
+	s.radius_     = s.radius_ / ratio_;
+	s.width_      = s.radius_ * w_ / 2.0f;
+	s.num_bucket_ = 0;
+	s.tid_        = 0;
+	memset(s.b_flag_, true, m_ * SIZEBOOL);
+	STATS(++stats_.rounds_);
+	STATS(stats_.tables_ += m_);
+}
+
+// -----------------------------------------------------------------------------
+void RQALSH::verify_state(			// verify the pending candidates
+	KFN_State &s)						// search state
+{
+	for (int i = 0; i < s.num_pend_; ++i) {
+		int id = s.pend_[i];
+		float dist = l2_dist_(dim_, s.query_, get_data(id));
+		s.list_->insert(dist, get_id(id) + 1);
+	}
+	STATS(stats_.verified_ += s.num_pend_);
+	s.num_pend_ = 0;
+}
+
+// -----------------------------------------------------------------------------
+void RQALSH::prefetch_state(		// prefetch the next hash table positions
+	KFN_State &s)						// search state
+{
+	int j = s.tid_;
+	while (!s.b_flag_[j]) {
+		if (++j == m_) j = 0;
+	}
+	// the left part is scanned forwards and the right part backwards; the 
+	// counters of the entries which will be scanned are prefetched as well
+	const Result *table = &tables_[j * n_pts_];
+	float q_v  = s.q_val_[j];
+	int   lpos = s.l_pos_[j];
+	int   rpos = s.r_pos_[j];
+	for (int cnt = 0; cnt < SCAN_SIZE && lpos < rpos; ++cnt, ++lpos) {
+		float ldist = fabs(q_v - table[lpos].key_);
+		if (ldist < s.width_ || ldist < s.range_) break;
+		__builtin_prefetch(&s.freq_[table[lpos].id_], 1);
+	}
+	for (int cnt = 0; cnt < SCAN_SIZE && lpos < rpos; ++cnt, --rpos) {
+		float rdist = fabs(q_v - table[rpos].key_);
+		if (rdist < s.width_ || rdist < s.range_) break;
+		__builtin_prefetch(&s.freq_[table[rpos].id_], 1);
+	}
+}
+
+// -----------------------------------------------------------------------------
+void RQALSH::release_state(			// release the search state
+	KFN_State &s)						// search state
+{
+	delete[] s.freq_;    s.freq_    = NULL;
+	delete[] s.l_pos_;   s.l_pos_   = NULL;
+	delete[] s.r_pos_;   s.r_pos_   = NULL;
+	delete[] s.b_flag_;  s.b_flag_  = NULL;
+	delete[] s.r_flag_;  s.r_flag_  = NULL;
+	delete[] s.q_val_;   s.q_val_   = NULL;
+}
+
 // -----------------------------------------------------------------------------
 float RQALSH::find_radius(			// find proper radius
 	const int   *l_pos,					// left  position of query in hash table
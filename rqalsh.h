@@ -10,8 +10,90 @@
 #include "def.h"
 #include "util.h"
 #include "random.h"
+#include "proj.h"
 #include "pri_queue.h"
 
+// -----------------------------------------------------------------------------
+//  search statistics of RQALSH::kfn, collected only if compiled with 
+//  -DRQALSH_STATS (make STATS=1); otherwise STATS(...) expands to nothing
+// -----------------------------------------------------------------------------
+#ifdef RQALSH_STATS
+#define STATS(x) x
+#else
+#define STATS(x)
+#endif
+
+struct Search_Stats {
+	int64_t queries_;				// number of queries
+	int64_t rounds_;				// number of radius rounds
+	int64_t tables_;				// number of hash tables visited
+	int64_t scanned_;				// number of table entries scanned
+	int64_t max_scanned_;			// max entries scanned in one table
+	int64_t verified_;				// number of ids reaching threshold l
+	double  proj_time_;				// time of query projection (ms)
+	double  scan_time_;				// time of table scanning (ms)
+	double  verify_time_;			// time of distance verification (ms)
+};
+
+// -----------------------------------------------------------------------------
+void add_stats(						// accumulate search statistics
+	const Search_Stats &src,			// source statistics
+	Search_Stats &dst);					// target statistics (return)
+
+// -----------------------------------------------------------------------------
+void display_stats_header(			// display header of search statistics
+	FILE  *fp);							// output file
+
+// -----------------------------------------------------------------------------
+void display_stats(					// display one row of search statistics
+	FILE  *fp,							// output file
+	int   bid,							// block id (-1: total)
+	int   n,							// cardinality
+	int   m,							// number of hash tables
+	const Search_Stats &stats);			// search statistics
+
+// -----------------------------------------------------------------------------
+void calc_rqalsh_params(			// calc bucket width, #tables and threshold
+	int   n,							// cardinality
+	float ratio,						// approximation ratio
+	float &w,							// bucket width (return)
+	int   &m,							// number of hash tables (return)
+	int   &l);							// collision threshold (return)
+
+// -----------------------------------------------------------------------------
+int calibrate_n_threshold(			// calibrate max #objects scanned exactly
+	int   d,							// dimensionality
+	float ratio,						// approximation ratio
+	int   proj);						// projection family
+
+// -----------------------------------------------------------------------------
+//  KFN_State: state of one query of RQALSH::kfn_group, so that the search can 
+//  be suspended after scanning one hash table and resumed later
+// -----------------------------------------------------------------------------
+struct KFN_State {
+	const float *query_;			// input query
+	MaxK_List *list_;				// c-k-AFN results
+	unsigned short *freq_;			// separation counting frequency (<= l_)
+	int   *l_pos_;					// left  position of query
+	int   *r_pos_;					// right position of query
+	bool  *b_flag_;					// bucket flag
+	bool  *r_flag_;					// range  flag
+	float *q_val_;					// hash value of query
+
+	int   cand_;					// candidate size
+	int   cand_cnt_;				// candidate counter
+	int   num_bucket_;				// number of bucket flag
+	int   num_range_;				// number of search range flag
+	int   tid_;						// next hash table to scan
+	float radius_;					// search radius
+	float width_;					// bucket width
+	float range_;					// search range
+	bool  done_;					// is the search finished?
+
+	int   num_pend_;				// number of candidates to verify
+	int   pend_[2 * SCAN_SIZE];		// candidates to verify (rows prefetched)
+};
+
 // -----------------------------------------------------------------------------
 //  RQALSH: basic data structure for high-dimensional c-k-AFN search
 // -----------------------------------------------------------------------------
@@ -23,7 +105,24 @@ public:
 		int   d,						// dimensionality
 		float ratio,					// approximation ratio
 		const int *index,				// index of data objects
-		const float *data);				// data objects
+		const float *data,				// data objects
+		bool  packed,					// pack data objects contiguously?
+		int   seed,						// random seed
+		int   proj = PROJ_DENSE,		// projection family (if not bank)
+		const Projection *bank = NULL,	// shared hash functions (NULL: own)
+		Arena *arena = NULL,			// owner of tables (NULL: heap)
+		int   n_thres = N_THRESHOLD);	// max #objects scanned exactly
+
+	// -------------------------------------------------------------------------
+	RQALSH(							// constructor (streaming)
+		int   n,						// cardinality
+		int   d,						// dimensionality
+		float ratio,					// approximation ratio
+		const char *fname,				// address of data objects
+		float *data,					// data objects (return)
+		int   seed,						// random seed
+		int   proj = PROJ_DENSE,		// projection family
+		int   n_thres = N_THRESHOLD);	// max #objects scanned exactly
 
 	// -------------------------------------------------------------------------
 	~RQALSH();						// destructor
@@ -36,14 +135,72 @@ public:
 		int   top_k,					// top-k value
 		float R,						// limited search range
 		const float *query,				// input query
-		MaxK_List *list);				// c-k-AFN results (return)
+		MaxK_List *list,				// c-k-AFN results (return)
+		const float *q_val = NULL);		// hash values by the bank (NULL: calc)
+
+	// -------------------------------------------------------------------------
+	int kfn(						// c-k-AFN search with budget and deadline
+		int   top_k,					// top-k value
+		float R,						// limited search range
+		int   budget,					// candidate budget (0: CANDIDATES+k-1)
+		double deadline,				// deadline by get_cur_time() (0: none)
+		const float *query,				// input query
+		MaxK_List *list,				// c-k-AFN results (return)
+		bool  &finished,				// terminated normally? (return)
+		const float *q_val = NULL);		// hash values by the bank (NULL: calc)
+
+	// -------------------------------------------------------------------------
+	void kfn_group(					// interleaved c-k-AFN search of queries
+		int   top_k,					// top-k value
+		int   num,						// number of queries
+		const float *R,					// limited search range of each query
+		const float **query,			// input queries
+		MaxK_List **list,				// c-k-AFN results (return)
+		int   *check,					// number of checked objects (return)
+		const float **q_val = NULL);	// hash values by the bank (NULL: calc)
+
+#ifdef RQALSH_STATS
+	// -------------------------------------------------------------------------
+	void reset_stats()				// reset search statistics
+	{
+		memset(&stats_, 0, sizeof(stats_));
+	}
+
+	// -------------------------------------------------------------------------
+	void display_stats(				// display search statistics
+		FILE *fp,						// output file
+		int  bid = 0)					// block id (-1: total)
+	{
+		::display_stats(fp, bid, n_pts_, m_, stats_);
+	}
+
+	// -------------------------------------------------------------------------
+	const Search_Stats &get_stats()	// get search statistics
+	{
+		return stats_;
+	}
+#endif
+
+	// -------------------------------------------------------------------------
+	inline int get_num_tables()		// get number of hash tables
+	{
+		return m_;
+	}
+
+	// -------------------------------------------------------------------------
+	inline void set_prefetch(		// set prefetch distance of kfn()
+		int dist)						// prefetch distance (0: no prefetch)
+	{
+		pf_dist_ = dist;
+	}
 
 	// -------------------------------------------------------------------------
 	int64_t get_memory_usage()		// get memory usage
 	{
 		int64_t ret = 0;
 		ret += sizeof(*this);
-		if (proj_a_ != NULL) ret += SIZEFLOAT * m_ * dim_; // proj_a_
+		if (own_proj_) ret += proj_->get_memory_usage(); // proj_
+		if (packed_data_ != NULL) ret += SIZEFLOAT * n_pts_ * dim_; // packed
 		if (tables_ != NULL) ret += sizeof(Result) * m_ * n_pts_; // tables_
 		return ret;
 	}
@@ -57,18 +214,70 @@ protected:
 	int   l_;						// collision threshold
 	const int   *index_;			// index of data objects
 	const float *data_;				// data objects
+	float  *packed_data_;			// data objects packed by index (or NULL)
+	int    pf_dist_;				// prefetch distance of kfn()
+	Dist_Func  l2_dist_;			// calc_l2_dist() for dim_
+	Batch_Func l2_dist_batch_;		// calc_l2_dist_batch() for dim_
 
-	float  *proj_a_;				// hash functions
+	const Projection *proj_;		// hash functions (the first m_ ones)
+	bool   own_proj_;				// is proj_ owned (not a shared bank)?
+	Arena  *arena_;					// owner of tables_, packed_data_ (or NULL)
 	Result *tables_;				// hash tables
+#ifdef RQALSH_STATS
+	Search_Stats stats_;			// search statistics
+#endif
 	
 	// -------------------------------------------------------------------------
-	float calc_l2_prob(				// calc <p1> and <p2> for L_{2.0} distance
-		float x);						// x = w / (2.0 * r)
+	inline const float *get_data(	// get data object by its local id
+		int id)							// local id (0 ~ n_pts_-1)
+	{
+		if (packed_data_ != NULL) return &packed_data_[id * dim_];
+		return &data_[get_id(id) * dim_];
+	}
+
+	// -------------------------------------------------------------------------
+	inline int get_id(				// get global id of data object
+		int id)							// local id (0 ~ n_pts_-1)
+	{
+		return index_ != NULL ? index_[id] : id;
+	}
+
+	// -------------------------------------------------------------------------
+	void init_hash(					// init parameters and hash functions
+		int   seed,						// random seed
+		int   proj,						// projection family (if not bank)
+		const Projection *bank,			// shared hash functions (NULL: own)
+		int   n_thres);					// max #objects scanned exactly
+
+	// -------------------------------------------------------------------------
+	void hash_rows(					// hash data objects [s, e) into tables
+		int   s,						// start local id
+		int   e);						// end   local id
+
+	// -------------------------------------------------------------------------
+	void init_state(				// init the search state of one query
+		int   top_k,					// top-k value
+		float R,						// limited search range
+		const float *query,				// input query
+		MaxK_List *list,				// c-k-AFN results
+		const float *q_val,				// hash values by the bank (NULL: calc)
+		KFN_State &s);					// search state (return)
+
+	// -------------------------------------------------------------------------
+	void step_state(				// scan one hash table for one query
+		KFN_State &s);					// search state
+
+	// -------------------------------------------------------------------------
+	void verify_state(				// verify the pending candidates
+		KFN_State &s);					// search state
+
+	// -------------------------------------------------------------------------
+	void prefetch_state(			// prefetch the next hash table positions
+		KFN_State &s);					// search state
 
 	// -------------------------------------------------------------------------
-	float calc_hash_value(			// calc hash value
-		int   tid,						// hash table id
-		const float *data);				// one data object
+	void release_state(				// release the search state
+		KFN_State &s);					// search state
 
 	// -------------------------------------------------------------------------
 	float find_radius(				// find proper radius					
@@ -7,132 +7,27 @@ RQALSH_STAR::RQALSH_STAR(			// constructor
 	int   L,							// number of proj
 	int   M,							// number of candidates
 	float ratio,						// approximation ratio
-	const float *data)					// data objects
-	: n_pts_(n), dim_(d), L_(L), M_(M), data_(data), lsh_(NULL)
-{
-	// get candidates from data dependent selection
-	int n_cand = L * M;
-	cand_ = new int[n_cand];
-	data_dependent_select(data, cand_);
-
-	//  build rqalsh if necessary
-	lsh_ = new RQALSH(n_cand, d, ratio, (const int*) cand_, data);
-}
-
-// -----------------------------------------------------------------------------
-void RQALSH_STAR::data_dependent_select(// data dependent selection
+	bool  fold,							// fold centering into the math?
+	bool  packed,						// pack candidates contiguously?
 	const float *data,					// data objects
-	int   *cand)						// candidate id (return)
-{
-	// -------------------------------------------------------------------------
-	//  calc the shift data
-	// -------------------------------------------------------------------------
-	int   max_id      = -1;
-	float max_norm    = -1.0f;
-	float *norm       = new float[n_pts_];
-	float *shift_data = new float[n_pts_ * dim_];
-
-	calc_shift_data(max_id, max_norm, norm, shift_data);
-
-	// -------------------------------------------------------------------------
-	//  data dependent selection
-	// -------------------------------------------------------------------------
-	float  *proj  = new float[dim_];
-	Result *score = new Result[n_pts_];
-	for (int i = 0; i < L_; ++i) {
-		// ---------------------------------------------------------------------
-		//  select the projection vector with largest norm and normalize it
-		// ---------------------------------------------------------------------
-		for (int j = 0; j < dim_; ++j) {
-			proj[j] = shift_data[max_id*dim_+j] / norm[max_id];
-		}
-
-		// ---------------------------------------------------------------------
-		//  calculate offsets and distortions
-		// ---------------------------------------------------------------------
-		for (int j = 0; j < n_pts_; ++j) {
-			if (norm[j] >= 0.0f) {
-				float offset = calc_inner_product(dim_, &shift_data[j*dim_], proj);
-
-				float distortion = 0.0F;
-				for (int k = 0; k < dim_; ++k) {
-					distortion += SQR(shift_data[j*dim_+k] - offset * proj[k]);
-				}
-				score[j].id_  = j;
-				score[j].key_ = offset * offset - distortion;
-			}
-			else {
-				score[j].id_  = j;
-				score[j].key_ = MINREAL;
-			}
-		}
-
-		// ---------------------------------------------------------------------
-		//  collect the objects that are well-represented by this projection
-		// ---------------------------------------------------------------------
-		qsort(score, n_pts_, sizeof(Result), ResultCompDesc);
-		for (int j = 0; j < M_; ++j) {
-			int id = score[j].id_;
-
-			cand[i * M_ + j] = id;
-			norm[id] = -1.0f;
-		}
-
-		// ---------------------------------------------------------------------
-		//  find the next largest norm and the corresponding object
-		// ---------------------------------------------------------------------
-		max_id = -1;
-		max_norm = -1.0f;
-		for (int j = 0; j < n_pts_; ++j) {
-			if (norm[j] > max_norm) { max_norm = norm[j]; max_id = j; }
-		}
-	}
-	// -------------------------------------------------------------------------
-	//  release space
-	// -------------------------------------------------------------------------
-	delete[] norm;
-	delete[] proj;
-	delete[] score;
-	delete[] shift_data;
-}
-
-// -----------------------------------------------------------------------------
-void RQALSH_STAR::calc_shift_data(	// calculate shift data objects
-	int   &max_id,						// data id with max l2-norm (return)
-	float &max_norm,					// max l2-norm (return)
-	float *norm,						// l2-norm of shift data (return)
-	float *shift_data) 					// shift data (return)
+	int   proj,							// projection family
+	int   n_thres,						// max #objects scanned exactly
+	const int *cand)					// selected candidates (NULL: select)
+	: n_pts_(n), dim_(d), L_(L), M_(MIN(M, n)), fold_(fold), data_(data), lsh_(NULL)
 {
-	// -------------------------------------------------------------------------
-	//  calculate the centroid of data objects
-	// -------------------------------------------------------------------------
-	std::vector<float> centroid(dim_, 0.0f);
-	for (int i = 0; i < n_pts_; ++i) {
-		for (int j = 0; j < dim_; ++j) {
-			centroid[j] += data_[i*dim_ + j];
-		}
-	}
-	for (int i = 0; i < dim_; ++i) centroid[i] /= n_pts_;
-
-	// -------------------------------------------------------------------------
-	//  calc shift data and their l2-norm and find max l2-norm and its id
-	// -------------------------------------------------------------------------
-	max_id   = -1;
-	max_norm = MINREAL;
-
-	for (int i = 0; i < n_pts_; ++i) {
-		norm[i] = 0.0f;
-		for (int j = 0; j < dim_; ++j) {
-			float tmp = data_[i*dim_+j] - centroid[j];
-			
-			shift_data[i*dim_+j] = tmp;
-			norm[i] += tmp * tmp;
-		}
-		norm[i] = sqrt(norm[i]);
-
-		if (norm[i] > max_norm) { max_norm = norm[i]; max_id = i; }
-	}
-	centroid.clear(); centroid.shrink_to_fit();
+	// get candidates from data dependent selection (M is capped by n to keep 
+	// every slot of cand_ filled), or from a selection by dd_select() with 
+	// the same M and fold
+	int n_cand = L * M_;
+	cand_ = new int[n_cand];
+	if (cand != NULL) memcpy(cand_, cand, SIZEINT * n_cand);
+	else dd_select(n, d, L, M_, 1, fold, data, cand_);
+
+	//  build rqalsh if necessary: if packed, the candidates are copied into 
+	//  rqalsh, and the data objects are no longer referenced
+	lsh_ = new RQALSH(n_cand, d, ratio, (const int*) cand_, data, packed, MAGIC, 
+		proj, NULL, NULL, n_thres);
+	if (packed) data_ = NULL;
 }
 
 // -----------------------------------------------------------------------------
@@ -149,7 +44,8 @@ void RQALSH_STAR::display()			// display parameters
 	printf("    n = %d\n",   n_pts_);
 	printf("    d = %d\n",   dim_);
 	printf("    L = %d\n",   L_);
-	printf("    M = %d\n\n", M_);
+	printf("    M = %d\n",   M_);
+	printf("    fold centering = %s\n\n", fold_ ? "true" : "false");
 
 	lsh_->display();
 }
@@ -162,3 +58,30 @@ int RQALSH_STAR::kfn(				// c-k-AFN search
 {
 	return lsh_->kfn(top_k, MINREAL, query, list);
 }
+
+// -----------------------------------------------------------------------------
+int RQALSH_STAR::kfn(				// c-k-AFN search with budget and deadline
+	int   top_k,						// top-k value
+	int   budget,						// candidate budget (0: CANDIDATES+k-1)
+	double deadline,					// deadline by get_cur_time() (0: none)
+	const float *query,					// query object
+	MaxK_List *list,					// k-FN results (return)
+	bool  &finished)					// terminated normally? (return)
+{
+	return lsh_->kfn(top_k, MINREAL, budget, deadline, query, list, finished);
+}
+
+// -----------------------------------------------------------------------------
+void RQALSH_STAR::kfn_group(		// interleaved c-k-AFN search of queries
+	int   top_k,						// top-k value
+	int   num,							// number of queries
+	const float **query,				// input queries
+	MaxK_List **list,					// top-k results (return)
+	int   *check)						// number of checked objects (return)
+{
+	float *R = new float[num];
+	for (int i = 0; i < num; ++i) R[i] = MINREAL;
+
+	lsh_->kfn_group(top_k, num, R, query, list, check);
+	delete[] R;
+}
@@ -11,6 +11,7 @@
 #include "util.h"
 #include "pri_queue.h"
 #include "rqalsh.h"
+#include "dd_select.h"
 
 // -----------------------------------------------------------------------------
 //  RQALSH_STAR is used for c-k-Approximate Furthest Neighbor (c-k-AFN) search
@@ -23,7 +24,12 @@ public:
 		int   L,						// number of projection
 		int   M,						// number of candidates
 		float ratio,					// approximation ratio
-		const float *data);				// data objects
+		bool  fold,						// fold centering into the math?
+		bool  packed,					// pack candidates contiguously?
+		const float *data,				// data objects
+		int   proj = PROJ_DENSE,		// projection family
+		int   n_thres = N_THRESHOLD,	// max #objects scanned exactly
+		const int *cand = NULL);		// selected candidates (NULL: select)
 
 	// -------------------------------------------------------------------------
 	~RQALSH_STAR();					// destructor
@@ -36,7 +42,33 @@ public:
 		int top_k,						// top-k value
 		const float *query,				// query object
 		MaxK_List *list);				// top-k results (return)
+
+	// -------------------------------------------------------------------------
+	int kfn(						// c-k-AFN search with budget and deadline
+		int   top_k,					// top-k value
+		int   budget,					// candidate budget (0: CANDIDATES+k-1)
+		double deadline,				// deadline by get_cur_time() (0: none)
+		const float *query,				// query object
+		MaxK_List *list,				// top-k results (return)
+		bool  &finished);				// terminated normally? (return)
+
+	// -------------------------------------------------------------------------
+	void kfn_group(					// interleaved c-k-AFN search of queries
+		int   top_k,					// top-k value
+		int   num,						// number of queries
+		const float **query,			// input queries
+		MaxK_List **list,				// top-k results (return)
+		int   *check);					// number of checked objects (return)
 	
+#ifdef RQALSH_STATS
+	// -------------------------------------------------------------------------
+	void display_stats(				// display search statistics
+		FILE *fp)						// output file
+	{
+		lsh_->display_stats(fp, 0);
+	}
+#endif
+
 	// -------------------------------------------------------------------------
 	int64_t get_memory_usage()		// get memory usage
 	{
@@ -52,20 +84,9 @@ protected:
 	int    dim_;					// dimensionality
 	int    L_;						// number of projections
 	int    M_;						// number of candidates for each proj
-	const float *data_;				// data objects
+	bool   fold_;					// fold centering into the math?
+	const float *data_;				// data objects (NULL if packed)
 
 	int    *cand_;					// candidate data objects id
 	RQALSH *lsh_;					// index of sample data objects
-
-	// -------------------------------------------------------------------------
-	void data_dependent_select(		// data dependent selection
-		const float *data,				// data objects
-		int   *cand);					// candidate id (return)
-			
-	// -------------------------------------------------------------------------
-	void calc_shift_data(			// calculate shift data objects
-		int   &max_id,					// data id with max l2-norm (return)
-		float &max_norm,				// max l2-norm (return)
-		float *norm,					// l2-norm of shift data (return)
-		float *shift_data); 			// shift data (return)
 };
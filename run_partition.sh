@@ -0,0 +1,30 @@
+#!/bin/bash
+make clean
+make
+
+# ------------------------------------------------------------------------------
+#  ML_RQALSH: fixed partition by LAMBDA (-pt 0) vs. cost model (-pt 1) on all 
+#  data sets, where the indexing time, memory and query results of both are 
+#  written to results${c}/${dname}/ml_rqalsh.out
+# ------------------------------------------------------------------------------
+c=2.0
+dname_list=(Mnist Trevi P53 Sift Gist)
+n_list=(59000 99900 30159 999000 999000)
+d_list=(50 4096 5408 128 960)
+qn=1000
+length=`expr ${#dname_list[*]} - 1`
+
+for j in $(seq 0 ${length})
+do 
+    dname=${dname_list[j]}
+    n=${n_list[j]}
+    d=${d_list[j]}
+    dPath=data/${dname}/${dname}
+    oPath=results${c}/${dname}/
+
+    for pt in 0 1
+    do
+        ./rqalsh -alg 6 -n ${n} -qn ${qn} -d ${d} -c ${c} -pt ${pt} \
+            -ds ${dPath}.ds -qs ${dPath}.q -ts ${dPath}.fn${c} -op ${oPath}
+    done
+done
@@ -0,0 +1,81 @@
+#include "trace.h"
+#include "util.h"
+
+#ifdef RQALSH_TRACE
+// -----------------------------------------------------------------------------
+struct Trace_Event {				// an event (open or finished)
+	const char *name_;				// name
+	int64_t arg_;					// argument (-1: none)
+	int     tid_;					// thread id
+	int     depth_;					// nesting depth on its thread
+	double  start_;					// start time (ms)
+	double  dur_;					// duration  (ms)
+};
+
+static double g_trace_start = get_cur_time(); // start of the timeline (ms)
+static std::mutex g_trace_mtx;		// lock of g_trace_events
+static std::vector<Trace_Event> g_trace_events; // finished events
+
+static thread_local std::vector<Trace_Event> g_trace_stack; // open events
+static thread_local int g_trace_tid = -1; // thread id (by gettid)
+
+// -----------------------------------------------------------------------------
+void trace_begin(					// begin an event on this thread
+	const char *name,					// name (string literal)
+	int64_t arg)						// argument (-1: none)
+{
+	if (g_trace_tid < 0) g_trace_tid = (int) syscall(SYS_gettid);
+
+	Trace_Event e;
+	e.name_  = name;
+	e.arg_   = arg;
+	e.tid_   = g_trace_tid;
+	e.depth_ = (int) g_trace_stack.size();
+	e.start_ = get_cur_time();
+	e.dur_   = 0.0;
+	g_trace_stack.push_back(e);
+}
+
+// -----------------------------------------------------------------------------
+void trace_end()					// end the last event on this thread
+{
+	if (g_trace_stack.empty()) return;
+
+	Trace_Event e = g_trace_stack.back();
+	g_trace_stack.pop_back();
+	e.dur_ = get_cur_time() - e.start_;
+
+	std::lock_guard<std::mutex> lock(g_trace_mtx);
+	g_trace_events.push_back(e);
+}
+
+// -----------------------------------------------------------------------------
+int write_trace(					// write all finished events
+	const char *fname)					// address of trace file (JSON)
+{
+	FILE *fp = fopen(fname, "w");
+	if (!fp) { printf("Could not create %s\n", fname); return 1; }
+
+	std::lock_guard<std::mutex> lock(g_trace_mtx);
+	int pid = (int) getpid();
+
+	// complete ("X") events, with timestamps in microseconds
+	fprintf(fp, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+	for (size_t i = 0; i < g_trace_events.size(); ++i) {
+		const Trace_Event &e = g_trace_events[i];
+		fprintf(fp, "{\"name\": \"%s\", \"cat\": \"rqalsh\", \"ph\": \"X\", "
+			"\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %d, "
+			"\"args\": {\"depth\": %d", e.name_, 
+			(e.start_ - g_trace_start) * 1000.0, e.dur_ * 1000.0, pid, e.tid_, 
+			e.depth_);
+		if (e.arg_ >= 0) fprintf(fp, ", \"arg\": %lld", (long long) e.arg_);
+		fprintf(fp, "}}%s\n", i + 1 < g_trace_events.size() ? "," : "");
+	}
+	fprintf(fp, "]}\n");
+	fclose(fp);
+
+	printf("Trace: %d events written to %s\n", (int) g_trace_events.size(), 
+		fname);
+	return 0;
+}
+#endif
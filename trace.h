@@ -0,0 +1,59 @@
+#pragma once
+
+#include <iostream>
+#include <cstdio>
+#include <vector>
+#include <mutex>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+// -----------------------------------------------------------------------------
+//  trace events of build and query phases, which are written as Chrome 
+//  trace-event JSON (chrome://tracing, Perfetto) by TRACE_WRITE(fname). The 
+//  layer is compiled in by -DRQALSH_TRACE (make TRACE=1); otherwise all the 
+//  macros expand to nothing.
+//
+//  TRACE_SCOPE(name [, arg])  traces the enclosing scope
+//  TRACE_BEGIN(name [, arg])  traces until the matching TRACE_END() on the 
+//  TRACE_END()                same thread
+//
+//  <name> must be a string literal, and <arg> is an optional integer (e.g., 
+//  a block id or #objects) shown with the event. Each thread keeps a stack of 
+//  open events, so the events nest per thread (the depth is shown as well).
+// -----------------------------------------------------------------------------
+#ifdef RQALSH_TRACE
+
+// -----------------------------------------------------------------------------
+void trace_begin(					// begin an event on this thread
+	const char *name,					// name (string literal)
+	int64_t arg = -1);					// argument (-1: none)
+
+// -----------------------------------------------------------------------------
+void trace_end();					// end the last event on this thread
+
+// -----------------------------------------------------------------------------
+int write_trace(					// write all finished events
+	const char *fname);					// address of trace file (JSON)
+
+// -----------------------------------------------------------------------------
+struct Trace_Scope {				// event of a scope
+	Trace_Scope(const char *name, int64_t arg = -1) { trace_begin(name, arg); }
+	~Trace_Scope() { trace_end(); }
+};
+
+#define TRACE_CAT2(a, b)	a##b
+#define TRACE_CAT(a, b)		TRACE_CAT2(a, b)
+#define TRACE_SCOPE(...)	Trace_Scope TRACE_CAT(trace_, __LINE__)(__VA_ARGS__)
+#define TRACE_BEGIN(...)	trace_begin(__VA_ARGS__)
+#define TRACE_END()			trace_end()
+#define TRACE_WRITE(fname)	write_trace(fname)
+
+#else
+
+#define TRACE_SCOPE(...)
+#define TRACE_BEGIN(...)
+#define TRACE_END()
+#define TRACE_WRITE(fname)
+
+#endif
@@ -0,0 +1,372 @@
+#include "tuner.h"
+
+static const float C_LIST[] = { 4.0f, 3.0f, 2.5f, 2.0f, 1.8f, 1.6f, 1.4f, 1.2f };
+static const int   C_NUM    = 8;
+static const int   MIN_L    = 8;		// min number of projections (QDAFN)
+static const int   MIN_B    = 16;		// min number of candidates (L * M)
+static const int   MAX_STALL = 2;		// max number of budgets w/o improvement
+
+// -----------------------------------------------------------------------------
+static float calc_time(				// calc elapsed time (seconds)
+	const timeval &start,				// start time
+	const timeval &end)					// end time
+{
+	return end.tv_sec - start.tv_sec + (end.tv_usec - start.tv_usec) / 1000000.0f;
+}
+
+// -----------------------------------------------------------------------------
+//  evaluate a configuration on the query sample: only the search is timed, 
+//  and the evaluation stops once the target cannot be met any longer
+// -----------------------------------------------------------------------------
+template<class KFN>
+static void evaluate(				// evaluate one configuration
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	int   top_k,						// top-k value
+	float target_recall,				// target recall (%)
+	float target_ratio,					// target overall ratio
+	const float *query,					// query set
+	const Result *R,					// truth set
+	KFN   kfn,							// c-k-AFN search
+	Tune_Result &res)					// performance (return)
+{
+	timeval start, end;
+	MaxK_List *list = new MaxK_List(top_k);
+
+	float recall = 0.0f, ratio = 0.0f, runtime = 0.0f;
+	int   i = 0;
+	res.feasible_ = true;
+	while (i < qn) {
+		list->reset();
+		gettimeofday(&start, NULL);
+		kfn(top_k, &query[i*d], list);
+		gettimeofday(&end, NULL);
+		runtime += calc_time(start, end);
+
+		recall += calc_recall(top_k, &R[i*MAXK], list);
+		ratio  += calc_ratio(top_k, &R[i*MAXK], list);
+		++i;
+
+		// early stop: the remaining queries are assumed to be exact
+		int rest = qn - i;
+		if ((recall + 100.0f * rest) / qn < target_recall || 
+			(ratio + 1.0f * rest) / qn > target_ratio) {
+			res.feasible_ = false;
+			break;
+		}
+	}
+	res.recall_  = recall / i;
+	res.ratio_   = ratio / i;
+	res.runtime_ = runtime * 1000.0f / i;
+	delete list;
+}
+
+// -----------------------------------------------------------------------------
+static void display(				// display one configuration
+	FILE  *fp,							// output file
+	const Tune_Result &res)				// performance
+{
+	static const char *name[7] = { "", "", "QDAFN", "Drusilla_Select", 
+		"RQALSH", "RQALSH*", "ML_RQALSH" };
+
+	printf("%-16s L=%-6d M=%-6d c=%.1f\t%.2f%%\t%.4f\t%.4f\t%.2f\t%.2f\t%s\n", 
+		name[res.alg_], res.L_, res.M_, res.c_, res.recall_, res.ratio_, 
+		res.runtime_, res.memory_, res.indextime_, 
+		res.feasible_ ? "yes" : "no");
+	fprintf(fp, "%s\t%d\t%d\t%f\t%f\t%f\t%f\t%f\t%f\t%d\n", name[res.alg_], 
+		res.L_, res.M_, res.c_, res.recall_, res.ratio_, res.runtime_, 
+		res.memory_, res.indextime_, res.feasible_ ? 1 : 0);
+}
+
+// -----------------------------------------------------------------------------
+static bool cheaper(				// is a cheaper than b?
+	const Tune_Result &a,				// 1st configuration
+	const Tune_Result &b)				// 2nd configuration
+{
+	if (a.runtime_ != b.runtime_) return a.runtime_ < b.runtime_;
+	return a.memory_ < b.memory_;
+}
+
+// -----------------------------------------------------------------------------
+//  RQALSH and ML_RQALSH: a larger c needs fewer hash tables (cheaper), so c 
+//  is decreased until the target is met
+// -----------------------------------------------------------------------------
+static void tune_rqalsh(			// tune c for RQALSH and ML_RQALSH
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	int   top_k,						// top-k value
+	int   alg,							// algorithm (4 or 6)
+	float target_recall,				// target recall (%)
+	float target_ratio,					// target overall ratio
+	const float *data,					// data set
+	const float *query,					// query set
+	const Result *R,					// truth set
+	FILE  *fp,							// output file
+	std::vector<Tune_Result> &results)	// results (return)
+{
+	timeval start, end;
+	for (int i = 0; i < C_NUM; ++i) {
+		Tune_Result res; res.alg_ = alg; res.L_ = 0; res.M_ = 0; 
+		res.c_ = C_LIST[i];
+
+		if (alg == 4) {
+			gettimeofday(&start, NULL);
+			RQALSH *lsh = new RQALSH(n, d, res.c_, NULL, data, false, MAGIC, 
+				g_proj, NULL, NULL, g_n_threshold);
+			gettimeofday(&end, NULL);
+			res.indextime_ = calc_time(start, end);
+			res.memory_ = lsh->get_memory_usage() / 1048576.0f;
+
+			evaluate(qn, d, top_k, target_recall, target_ratio, query, R, 
+				[&](int k, const float *q, MaxK_List *list) { 
+					return lsh->kfn(k, MINREAL, q, list); }, res);
+			delete lsh;
+		}
+		else {
+			gettimeofday(&start, NULL);
+			ML_RQALSH *lsh = new ML_RQALSH(n, d, res.c_, 0, false, data, 
+				g_proj, g_n_threshold, g_hugepage);
+			gettimeofday(&end, NULL);
+			res.indextime_ = calc_time(start, end);
+			res.memory_ = lsh->get_memory_usage() / 1048576.0f;
+
+			evaluate(qn, d, top_k, target_recall, target_ratio, query, R, 
+				[&](int k, const float *q, MaxK_List *list) { 
+					return lsh->kfn(k, q, list); }, res);
+			delete lsh;
+		}
+		display(fp, res);
+		results.push_back(res);
+		if (res.feasible_) break;
+	}
+}
+
+// -----------------------------------------------------------------------------
+//  QDAFN: one index is built for each L, and M is increased at query time. 
+//  A query costs about L*d (projection) + (M+k)*(d+log L) (verification), so 
+//  L is not increased once its projection cost exceeds the best found.
+// -----------------------------------------------------------------------------
+static void tune_qdafn(				// tune L and M for QDAFN
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	int   top_k,						// top-k value
+	float target_recall,				// target recall (%)
+	float target_ratio,					// target overall ratio
+	const float *data,					// data set
+	const float *query,					// query set
+	const Result *R,					// truth set
+	FILE  *fp,							// output file
+	std::vector<Tune_Result> &results)	// results (return)
+{
+	timeval start, end;
+	float best_cost = MAXREAL;
+	for (int L = MIN_L; L <= n; L *= 2) {
+		if ((float) L * d >= best_cost) break;
+
+		gettimeofday(&start, NULL);
+		QDAFN *hash = new QDAFN(n, d, L, 1, 2, 2.0f, data, MAGIC, g_proj);
+		gettimeofday(&end, NULL);
+		float indextime = calc_time(start, end);
+
+		for (int M = 1; M + top_k <= n; M *= 2) {
+			Tune_Result res; res.alg_ = 2; res.L_ = L; res.M_ = M; 
+			res.c_ = 0.0f; res.indextime_ = indextime;
+			res.memory_ = hash->get_memory_usage() / 1048576.0f;
+
+			hash->set_M(M);
+			evaluate(qn, d, top_k, target_recall, target_ratio, query, R, 
+				[&](int k, const float *q, MaxK_List *list) { 
+					return hash->kfn(k, q, list); }, res);
+			display(fp, res);
+			results.push_back(res);
+
+			if (res.feasible_) {
+				float cost = (float) L*d + (M+top_k) * (d+log((float) L)/log(2.0f));
+				best_cost = MIN(best_cost, cost);
+				break;
+			}
+		}
+		delete hash;
+	}
+}
+
+// -----------------------------------------------------------------------------
+//  Drusilla_Select and RQALSH*: a query costs about L*M distances, so the 
+//  budget L*M is doubled until the target is met. The selection is greedy, 
+//  so the first L rounds of a selection with L' > L rounds are the same as 
+//  the selection with L rounds; one selection for each M is kept and reused.
+//  The search stops early if the recall does not improve for MAX_STALL 
+//  budgets, e.g., when RQALSH* is limited by its CANDIDATES.
+// -----------------------------------------------------------------------------
+static void tune_dd(				// tune L and M for Drusilla and RQALSH*
+	int   n,							// number of data objects
+	int   qn,							// number of query objects
+	int   d,							// dimensionality
+	int   top_k,						// top-k value
+	int   alg,							// algorithm (3 or 5)
+	float ratio,						// approximation ratio for RQALSH*
+	bool  fold,							// fold centering into the math?
+	bool  packed,						// pack candidates contiguously?
+	float target_recall,				// target recall (%)
+	float target_ratio,					// target overall ratio
+	const float *data,					// data set
+	const float *query,					// query set
+	const Result *R,					// truth set
+	FILE  *fp,							// output file
+	std::vector<Tune_Result> &results)	// results (return)
+{
+	timeval start, end;
+	std::vector<int>   cache_L;		// number of rounds of cached selection
+	std::vector<float> cache_time;	// time of cached selection
+	std::vector<std::vector<int> > cache; // cached selection for each M
+
+	float best_recall = -1.0f;
+	int   stall = 0;
+	for (int B = MIN_B; B <= n; B *= 2) {
+		bool  found  = false;
+		float recall = -1.0f;
+		for (int m = 0, M = 1; M <= B; ++m, M *= 2) {
+			int L = B / M;
+			if ((int) cache.size() <= m) {
+				cache.push_back(std::vector<int>());
+				cache_L.push_back(0);
+				cache_time.push_back(0.0f);
+			}
+			// re-select with 2L rounds, so that the next budget can reuse it
+			if (cache_L[m] < L) {
+				int new_L = MIN(2 * L, n / M);
+				cache[m].resize(new_L * M);
+
+				gettimeofday(&start, NULL);
+				dd_select(n, d, new_L, M, alg == 3 ? 0 : 1, fold, data, 
+					cache[m].data());
+				gettimeofday(&end, NULL);
+				cache_L[m] = new_L;
+				cache_time[m] = calc_time(start, end);
+			}
+			const int *cand = cache[m].data();
+
+			Tune_Result res; res.alg_ = alg; res.L_ = L; res.M_ = M; 
+			res.c_ = alg == 3 ? 0.0f : ratio; 
+			res.indextime_ = cache_time[m] * L / cache_L[m];
+
+			// the indexes are built from the first L rounds of the selection, 
+			// so they are searched as by the drivers
+			if (alg == 3) {
+				gettimeofday(&start, NULL);
+				Drusilla_Select *drusilla = new Drusilla_Select(n, d, L, M, 
+					fold, packed, data, cand);
+				gettimeofday(&end, NULL);
+				res.indextime_ += calc_time(start, end);
+				res.memory_ = drusilla->get_memory_usage() / 1048576.0f;
+
+				evaluate(qn, d, top_k, target_recall, target_ratio, query, R, 
+					[&](int /*k*/, const float *q, MaxK_List *list) { 
+						return drusilla->kfn(q, list); }, res);
+				delete drusilla;
+			}
+			else {
+				gettimeofday(&start, NULL);
+				RQALSH_STAR *lsh = new RQALSH_STAR(n, d, L, M, ratio, fold, 
+					packed, data, g_proj, g_n_threshold, cand);
+				gettimeofday(&end, NULL);
+				res.indextime_ += calc_time(start, end);
+				res.memory_ = lsh->get_memory_usage() / 1048576.0f;
+
+				evaluate(qn, d, top_k, target_recall, target_ratio, query, R, 
+					[&](int k, const float *q, MaxK_List *list) { 
+						return lsh->kfn(k, q, list); }, res);
+				delete lsh;
+			}
+			display(fp, res);
+			results.push_back(res);
+			if (res.feasible_) found = true;
+			recall = MAX(recall, res.recall_);
+		}
+		if (found) break;
+
+		if (recall > best_recall + 1.0f) { best_recall = recall; stall = 0; }
+		else if (++stall >= MAX_STALL) break;
+	}
+}
+
+// -----------------------------------------------------------------------------
+int tune(							// tune parameters for c-k-AFN search
+	int   n,							// number of data objects
+	int   qn,							// number of query objects (sample)
+	int   d,							// dimensionality
+	int   top_k,						// top-k value
+	int   method,						// method (0 - all, 2 - 6, as -alg)
+	float ratio,						// approximation ratio for RQALSH*
+	bool  fold,							// fold centering into the math?
+	bool  packed,						// pack candidates contiguously?
+	float target_recall,				// target recall (%)
+	float target_ratio,					// target overall ratio
+	const float *data,					// data set
+	const float *query,					// query set (sample)
+	const Result *R,					// truth set
+	const char *out_path)				// output path
+{
+	char output_set[200]; sprintf(output_set, "%stuner.out", out_path);
+	FILE *fp = fopen(output_set, "a+");
+	if (!fp) { printf("Could not create %s\n", output_set); return 1; }
+
+	if (top_k < 1 || top_k > MAXK) top_k = MAXK;
+	if (target_ratio < 1.0f) target_ratio = MAXREAL;
+	if (ratio <= 1.0f) ratio = 2.0f;
+
+	printf("Parameter Tuning: top-k = %d, recall >= %.2f%%, ratio <= %.4f\n", 
+		top_k, target_recall, target_ratio);
+	printf("Method\t\t Params\t\t\t\tRecall\tRatio\tTime (ms)\tMemory (MB)"
+		"\tIndexing (s)\tTarget\n");
+	fprintf(fp, "Tuner: top_k=%d, recall=%f, ratio=%f\n", top_k, 
+		target_recall, target_ratio);
+
+	// -------------------------------------------------------------------------
+	//  search the configurations of each method
+	// -------------------------------------------------------------------------
+	std::vector<Tune_Result> results;
+	if (method == 0 || method == 2) {
+		tune_qdafn(n, qn, d, top_k, target_recall, target_ratio, data, query, 
+			R, fp, results);
+	}
+	if (method == 0 || method == 3) {
+		tune_dd(n, qn, d, top_k, 3, ratio, fold, packed, target_recall, 
+			target_ratio, data, query, R, fp, results);
+	}
+	if (method == 0 || method == 4) {
+		tune_rqalsh(n, qn, d, top_k, 4, target_recall, target_ratio, data, 
+			query, R, fp, results);
+	}
+	if (method == 0 || method == 5) {
+		tune_dd(n, qn, d, top_k, 5, ratio, fold, packed, target_recall, 
+			target_ratio, data, query, R, fp, results);
+	}
+	if (method == 0 || method == 6) {
+		tune_rqalsh(n, qn, d, top_k, 6, target_recall, target_ratio, data, 
+			query, R, fp, results);
+	}
+
+	// -------------------------------------------------------------------------
+	//  report the cheapest configuration by query time and memory
+	// -------------------------------------------------------------------------
+	int best = -1;
+	for (int i = 0; i < (int) results.size(); ++i) {
+		if (!results[i].feasible_) continue;
+		if (best < 0 || cheaper(results[i], results[best])) best = i;
+	}
+	printf("\nCheapest Configuration:\n");
+	fprintf(fp, "Cheapest:\n");
+	if (best >= 0) display(fp, results[best]);
+	else {
+		printf("No configuration meets the target.\n");
+		fprintf(fp, "None\n");
+	}
+	printf("\n");
+	fprintf(fp, "\n");
+	fclose(fp);
+
+	return 0;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <sys/time.h>
+
+#include "def.h"
+#include "util.h"
+#include "pri_queue.h"
+#include "qdafn.h"
+#include "dd_select.h"
+#include "drusilla_select.h"
+#include "rqalsh.h"
+#include "rqalsh_star.h"
+#include "ml_rqalsh.h"
+
+struct Result;
+
+// -----------------------------------------------------------------------------
+//  Tune_Result: the performance of one configuration on the query sample
+// -----------------------------------------------------------------------------
+struct Tune_Result {
+	int   alg_;						// algorithm (2 - 6, same as -alg)
+	int   L_;						// number of projections
+	int   M_;						// number of candidates
+	float c_;						// approximation ratio
+	float recall_;					// recall (%)
+	float ratio_;					// overall ratio
+	float runtime_;					// query time (ms)
+	float memory_;					// estimated memory usage (MB)
+	float indextime_;				// indexing time (seconds)
+	bool  feasible_;				// does it meet the target?
+};
+
+// -----------------------------------------------------------------------------
+//  parameter tuning: for each method, the configurations are searched from 
+//  the cheapest one under a cost model, and the search stops early once the 
+//  target recall and ratio are met on the query sample. An evaluation is 
+//  also stopped early once the target cannot be met by the remaining queries.
+//
+//  RQALSH, ML_RQALSH: c is decreased from C_LIST[0] until target is met
+//  QDAFN:             L is increased (one build per L), and M is increased 
+//                     at query time by reusing the same build
+//  Drusilla, RQALSH*: L*M is increased, and for each M, the selection with 
+//                     L' rounds is reused for all prefixes L <= L'
+// -----------------------------------------------------------------------------
+int tune(							// tune parameters for c-k-AFN search
+	int   n,							// number of data objects
+	int   qn,							// number of query objects (sample)
+	int   d,							// dimensionality
+	int   top_k,						// top-k value
+	int   method,						// method (0 - all, 2 - 6, as -alg)
+	float ratio,						// approximation ratio for RQALSH*
+	bool  fold,							// fold centering into the math?
+	bool  packed,						// pack candidates contiguously?
+	float target_recall,				// target recall (%)
+	float target_ratio,					// target overall ratio
+	const float *data,					// data set
+	const float *query,					// query set (sample)
+	const Result *R,					// truth set
+	const char *out_path);				// output path
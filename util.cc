@@ -11,6 +11,82 @@ float g_ratio     = -1.0f;			// global param: overall ratio
 float g_recall    = -1.0f;			// global param: recall (%)
 float g_fraction  = -1.0f;			// global param: fraction (%)
 
+bool  g_dump_latency = false;		// global param: dump per-query latency?
+int   g_group        = 1;			// global param: number of interleaved queries
+int   g_proj         = PROJ_DENSE;	// global param: projection family
+bool  g_stream       = false;		// global param: stream data into the build?
+bool  g_hugepage     = false;		// global param: arenas on huge pages?
+int   g_budget       = 0;			// global param: candidate budget per query
+float g_deadline     = 0.0f;		// global param: deadline per query (ms)
+int   g_n_threshold  = N_THRESHOLD;	// global param: max #objects scanned exactly
+
+Mem_Phase g_mem[MEM_PHASES] = {		// global param: memory usage of phases
+	{ -1.0f, -1.0f, -1.0f, -1.0f }, 
+	{ -1.0f, -1.0f, -1.0f, -1.0f }, 
+	{ -1.0f, -1.0f, -1.0f, -1.0f } };
+
+#ifdef RQALSH_MEMCOUNT
+// -----------------------------------------------------------------------------
+//  counting allocator: each block has a header with its size and the phase 
+//  in which it was allocated, so a block freed in a later phase is still 
+//  subtracted from the phase that allocated it (the index built in MEM_BUILD 
+//  stays in its heap bytes until it is deleted)
+// -----------------------------------------------------------------------------
+static const int MEM_HEADER = 16;	// header size (keeps 16-byte alignment)
+
+static std::atomic<int> g_mem_tag(MEM_PHASES); // current phase (MEM_PHASES: other)
+static std::atomic<int64_t> g_heap[MEM_PHASES + 1]; // live heap bytes
+static std::atomic<int64_t> g_peak_heap[MEM_PHASES + 1]; // peak heap bytes
+
+// -----------------------------------------------------------------------------
+void *operator new(					// counting operator new
+	size_t size)						// size (bytes)
+{
+	char *p = (char*) malloc(size + MEM_HEADER);
+	if (p == NULL) throw std::bad_alloc();
+
+	int tag = g_mem_tag.load(std::memory_order_relaxed);
+	*(int64_t*) p = (int64_t) size;
+	*(int*) (p + sizeof(int64_t)) = tag;
+
+	int64_t cur  = g_heap[tag].fetch_add(size) + size;
+	int64_t peak = g_peak_heap[tag].load(std::memory_order_relaxed);
+	while (cur > peak && !g_peak_heap[tag].compare_exchange_weak(peak, cur)) {}
+
+	return p + MEM_HEADER;
+}
+
+// -----------------------------------------------------------------------------
+//  kept out of line: once inlined into a caller in this file, gcc checks the 
+//  header access against the object returned by operator new
+// -----------------------------------------------------------------------------
+__attribute__((noinline))
+static void mem_free(				// release a block from operator new
+	void *ptr)							// pointer from operator new
+{
+	if (ptr == NULL) return;
+
+	char *p = (char*) ptr - MEM_HEADER;
+	g_heap[*(int*) (p + sizeof(int64_t))].fetch_sub(*(int64_t*) p);
+	free(p);
+}
+
+// -----------------------------------------------------------------------------
+void operator delete(				// counting operator delete
+	void *ptr) noexcept					// pointer from operator new
+{
+	mem_free(ptr);
+}
+
+// -----------------------------------------------------------------------------
+void operator delete(				// sized counting operator delete
+	void *ptr,							// pointer from operator new
+	size_t) noexcept					// size (the header is used instead)
+{
+	mem_free(ptr);
+}
+#endif
+
 // -----------------------------------------------------------------------------
 void create_dir(					// create directory
 	char *path)							// input path
@@ -34,6 +110,118 @@ void create_dir(					// create directory
 	}
 }
 
+// -----------------------------------------------------------------------------
+static float percentile(			// nearest-rank percentile of sorted array
+	int   n,							// number of elements
+	const double *arr,					// sorted array
+	double p)							// percentile (0, 1]
+{
+	int rank = (int) ceil(p * n) - 1;
+	if (rank < 0) rank = 0;
+	if (rank >= n) rank = n - 1;
+
+	return (float) arr[rank];
+}
+
+// -----------------------------------------------------------------------------
+void calc_latency(					// calc latency distribution
+	int   n,							// number of queries
+	double *lat,						// per-query latency (ms, sorted on return)
+	Latency &res)						// latency distribution (return)
+{
+	double sum = 0.0;
+	for (int i = 0; i < n; ++i) sum += lat[i];
+	std::sort(lat, lat + n);
+
+	res.mean_ = (float) (sum / n);
+	res.min_  = (float) lat[0];
+	res.p50_  = percentile(n, lat, 0.5);
+	res.p90_  = percentile(n, lat, 0.9);
+	res.p99_  = percentile(n, lat, 0.99);
+	res.p999_ = percentile(n, lat, 0.999);
+	res.max_  = (float) lat[n - 1];
+}
+
+// -----------------------------------------------------------------------------
+int64_t get_rss(					// get resident set size (bytes, -1: n/a)
+	bool  peak)							// peak (VmHWM) or current (VmRSS)?
+{
+	FILE *fp = fopen("/proc/self/status", "r");
+	if (!fp) return -1;
+
+	const char *key = peak ? "VmHWM:" : "VmRSS:";
+	char    line[256];
+	int64_t ret = -1;
+	while (fgets(line, sizeof(line), fp)) {
+		if (strncmp(line, key, strlen(key)) == 0) {
+			ret = atoll(line + strlen(key)) * 1024; // in kB
+			break;
+		}
+	}
+	fclose(fp);
+	return ret;
+}
+
+// -----------------------------------------------------------------------------
+void begin_mem_phase(				// begin a phase of memory measurement
+	int   phase)						// phase (MEM_LOAD, ...)
+{
+	// reset the peak RSS to the current RSS (Linux >= 4.0); if this fails, 
+	// the peak RSS is the peak since the start of the process
+	FILE *fp = fopen("/proc/self/clear_refs", "w");
+	if (fp) { fputs("5", fp); fclose(fp); }
+
+#ifdef RQALSH_MEMCOUNT
+	g_peak_heap[phase] = g_heap[phase].load();
+	g_mem_tag = phase;
+#else
+	(void) phase;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+void end_mem_phase(					// end a phase of memory measurement
+	int   phase)						// phase (MEM_LOAD, ...)
+{
+	const float MB = 1048576.0f;
+	Mem_Phase &mem = g_mem[phase];
+
+	mem.rss_      = get_rss(false) / MB;
+	mem.peak_rss_ = get_rss(true)  / MB;
+#ifdef RQALSH_MEMCOUNT
+	g_mem_tag      = MEM_PHASES;
+	mem.heap_      = g_heap[phase].load() / MB;
+	mem.peak_heap_ = g_peak_heap[phase].load() / MB;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+void display_mem(					// display measured and estimated memory
+	FILE  *fp)							// output file
+{
+	const char *name[MEM_PHASES] = { "load", "build", "query" };
+
+	printf("Phase\t\tRSS (MB)\tPeak RSS (MB)\tHeap (MB)\tPeak Heap (MB)\n");
+	for (int i = 0; i < MEM_PHASES; ++i) {
+		const Mem_Phase &mem = g_mem[i];
+		if (mem.rss_ < 0.0f) continue;
+
+		printf("%s\t\t%.2f\t\t%.2f", name[i], mem.rss_, mem.peak_rss_);
+		if (mem.heap_ >= 0.0f) {
+			printf("\t\t%.2f\t\t%.2f\n", mem.heap_, mem.peak_heap_);
+		}
+		else printf("\t\t-\t\t-\n");
+		fprintf(fp, "Memory (%s): RSS %f MB, Peak RSS %f MB, Heap %f MB, "
+			"Peak Heap %f MB\n", name[i], mem.rss_, mem.peak_rss_, mem.heap_, 
+			mem.peak_heap_);
+	}
+	if (g_memory >= 0.0f) {
+		printf("Estimated Memory of Index = %f MB\n", g_memory);
+	}
+	printf("\n");
+	fprintf(fp, "\n");
+}
+
 // -----------------------------------------------------------------------------
 int read_bin_data(					// read data (binary) from disk
 	int   n,							// number of data points
@@ -46,7 +234,7 @@ int read_bin_data(					// read data (binary) from disk
 	FILE *fp = fopen(fname, "rb");
 	if (!fp) { printf("Could not open %s\n", fname); return 1; }
 
-	fread(data, SIZEFLOAT, n * d, fp);
+	fread(data, SIZEFLOAT, (int64_t) n * d, fp);
 	fclose(fp);
 
 	gettimeofday(&g_end_time, NULL);
@@ -59,6 +247,82 @@ int read_bin_data(					// read data (binary) from disk
 	return 0;
 }
 
+// -----------------------------------------------------------------------------
+int stream_bin_data(				// stream data (binary) from disk
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	int   chunk,						// number of objects per chunk
+	const char *fname,					// address of data
+	float *data,						// data (return)
+	const std::function<void(int, int)> &consume) // consume objects [s, e)
+{
+	double start_time = get_cur_time();
+	FILE *fp = fopen(fname, "rb");
+	if (!fp) { printf("Could not open %s\n", fname); return 1; }
+
+	// -------------------------------------------------------------------------
+	//  reader: <ready> objects have been read (-1: read error)
+	// -------------------------------------------------------------------------
+	std::mutex mtx;
+	std::condition_variable cv;
+	int    ready = 0;
+	double read_time = 0.0;
+
+	std::thread reader([&]() {
+		for (int s = 0; s < n; s += chunk) {
+			int e = MIN(s + chunk, n);
+			TRACE_SCOPE("read chunk", s);
+			int64_t size = (int64_t) (e - s) * d;
+			int64_t cnt  = fread(&data[(int64_t) s * d], SIZEFLOAT, size, fp);
+			{
+				std::lock_guard<std::mutex> lock(mtx);
+				ready = (cnt == size) ? e : -1;
+			}
+			cv.notify_one();
+			if (cnt != size) break;
+		}
+		read_time = get_cur_time() - start_time;
+	});
+
+	// -------------------------------------------------------------------------
+	//  consumer: build each chunk once it has been read
+	// -------------------------------------------------------------------------
+	int ret = 0;
+	for (int s = 0; s < n; s += chunk) {
+		int e = MIN(s + chunk, n);
+		{
+			std::unique_lock<std::mutex> lock(mtx);
+			cv.wait(lock, [&]() { return ready < 0 || ready >= e; });
+			if (ready < 0) { ret = 1; break; }
+		}
+		consume(s, e);
+	}
+	reader.join();
+	fclose(fp);
+
+	if (ret) printf("Could not read %d objects from %s\n", n, fname);
+	else printf("Read Data:  %f Seconds (streamed)\n", read_time / 1000.0);
+	return ret;
+}
+
+// -----------------------------------------------------------------------------
+void add_sorted_run(				// add a sorted run and merge runs
+	int   e,							// end of the new run
+	bool  last,							// is it the last run?
+	std::vector<int> &runs,				// start of runs, then end (return)
+	const std::function<void(int, int, int)> &merge) // merge [lo,mid),[mid,hi)
+{
+	runs.push_back(e);
+	while (runs.size() >= 3) {
+		int k   = (int) runs.size() - 1;
+		int lo  = runs[k-2], mid = runs[k-1], hi = runs[k];
+		if (!last && mid - lo > hi - mid) break;
+
+		merge(lo, mid, hi);
+		runs.erase(runs.begin() + (k-1));
+	}
+}
+
 // -----------------------------------------------------------------------------
 int read_ground_truth(				// read ground truth results from disk
 	int qn,								// number of query objects
@@ -93,17 +357,260 @@ int read_ground_truth(				// read ground truth results from disk
 	return 0;
 }
 
+// -----------------------------------------------------------------------------
+//  the kernels are instantiated with D > 0 for the dimensions in KERNEL_DIMS, 
+//  and with D = 0 (the dimension is given at runtime) for the others
+// -----------------------------------------------------------------------------
+const int LANES = 8;				// number of accumulators of fixed kernels
+
+// -----------------------------------------------------------------------------
+static inline float sum_lanes(		// sum up the accumulators in fixed order
+	const float *acc)					// LANES accumulators
+{
+	return ((acc[0] + acc[4]) + (acc[2] + acc[6])) + 
+		((acc[1] + acc[5]) + (acc[3] + acc[7]));
+}
+
+// -----------------------------------------------------------------------------
+template<int D>
+static float l2_dist_kernel(		// calc L_2 norm (data type is float)
+	int   dim,							// dimension (used if D = 0)
+	const float *p1,					// 1st point
+	const float *p2)					// 2nd point
+{
+	float ret = 0.0F;
+	if (D > 0) {
+		// dimension i is added to accumulator i % LANES; the accumulators are 
+		// independent, so the unrolled loop is vectorized
+		float acc[LANES] = { 0.0F };
+		int i = 0;
+		for (; i + LANES <= D; i += LANES) {
+			for (int t = 0; t < LANES; ++t) acc[t] += SQR(p1[i+t] - p2[i+t]);
+		}
+		if (D % LANES != 0) {			// tail only when D is not a multiple
+			for (; i < D; ++i) acc[i % LANES] += SQR(p1[i] - p2[i]);
+		}
+		ret = sum_lanes(acc);
+	}
+	else {
+		for (int i = 0; i < dim; ++i) {
+			ret += SQR(p1[i] - p2[i]);
+		}
+	}
+	return sqrt(ret);
+}
+
+// -----------------------------------------------------------------------------
+template<int D>
+static float inner_product_kernel(	// calc inner product (data type is float)
+	int   dim,							// dimension (used if D = 0)
+	const float *p1,					// 1st point
+	const float *p2)					// 2nd point
+{
+	float ret = 0.0F;
+	if (D > 0) {
+		float acc[LANES] = { 0.0F };
+		int i = 0;
+		for (; i + LANES <= D; i += LANES) {
+			for (int t = 0; t < LANES; ++t) acc[t] += p1[i+t] * p2[i+t];
+		}
+		if (D % LANES != 0) {
+			for (; i < D; ++i) acc[i % LANES] += p1[i] * p2[i];
+		}
+		ret = sum_lanes(acc);
+	}
+	else {
+		for (int i = 0; i < dim; ++i) {
+			ret += p1[i] * p2[i];
+		}
+	}
+	return ret;
+}
+
+// -----------------------------------------------------------------------------
+template<int D>
+static void l2_dist_batch_kernel(	// calc L_2 norm of a batch of points
+	int   n,							// number of points in the batch
+	int   dim,							// dimension (used if D = 0)
+	const float *query,					// query point
+	const float *data,					// contiguous points (n * dim)
+	float *dist)						// L_2 norm of each point (return)
+{
+	// -------------------------------------------------------------------------
+	//  the fixed kernel already has independent accumulators, so the points 
+	//  are processed one by one
+	// -------------------------------------------------------------------------
+	if (D > 0) {
+		for (int i = 0; i < n; ++i) {
+			dist[i] = l2_dist_kernel<D>(D, query, &data[(int64_t) i * D]);
+		}
+		return;
+	}
+
+	// -------------------------------------------------------------------------
+	//  8 points are processed together with independent accumulators, which 
+	//  hides the latency of the additions; each point still sums dimensions 
+	//  in order, so the results are the same as calc_l2_dist()
+	// -------------------------------------------------------------------------
+	const int d = dim;
+	int i = 0;
+	for (; i + LANES <= n; i += LANES) {
+		const float *x = &data[(int64_t) i * d];
+		float ret[LANES] = { 0.0F };
+
+		for (int j = 0; j < d; ++j) {
+			float q = query[j];
+			for (int t = 0; t < LANES; ++t) {
+				ret[t] += SQR(x[t*d+j] - q);
+			}
+		}
+		for (int t = 0; t < LANES; ++t) dist[i+t] = sqrt(ret[t]);
+	}
+	for (; i < n; ++i) {
+		dist[i] = l2_dist_kernel<0>(d, query, &data[(int64_t) i * d]);
+	}
+}
+
 // -----------------------------------------------------------------------------
 float calc_l2_dist(					// calc L_2 norm (data type is float)
 	int   dim,							// dimension
 	const float *p1,					// 1st point
 	const float *p2)					// 2nd point
 {
-	float ret  = 0.0F;
-	for (int i = 0; i < dim; ++i) {
-		ret += SQR(p1[i] - p2[i]);
+	return l2_dist_kernel<0>(dim, p1, p2);
+}
+
+// -----------------------------------------------------------------------------
+void calc_l2_dist_batch(			// calc L_2 norm of a batch of points
+	int   n,							// number of points in the batch
+	int   dim,							// dimension
+	const float *query,					// query point
+	const float *data,					// contiguous points (n * dim)
+	float *dist)						// L_2 norm of each point (return)
+{
+	l2_dist_batch_kernel<0>(n, dim, query, data, dist);
+}
+
+// -----------------------------------------------------------------------------
+Dist_Func get_l2_dist_func(			// get calc_l2_dist() for a dimension
+	int   dim)							// dimension
+{
+	switch (dim) {
+#define KERNEL_CASE(D) case D: return l2_dist_kernel<D>;
+	KERNEL_DIMS(KERNEL_CASE)
+#undef KERNEL_CASE
+	default: return calc_l2_dist;
 	}
-	return sqrt(ret);
+}
+
+// -----------------------------------------------------------------------------
+Dist_Func get_inner_product_func(	// get calc_inner_product() for a dimension
+	int   dim)							// dimension
+{
+	switch (dim) {
+#define KERNEL_CASE(D) case D: return inner_product_kernel<D>;
+	KERNEL_DIMS(KERNEL_CASE)
+#undef KERNEL_CASE
+	default: return calc_inner_product;
+	}
+}
+
+// -----------------------------------------------------------------------------
+Batch_Func get_l2_dist_batch_func(	// get calc_l2_dist_batch() for a dimension
+	int   dim)							// dimension
+{
+	switch (dim) {
+#define KERNEL_CASE(D) case D: return l2_dist_batch_kernel<D>;
+	KERNEL_DIMS(KERNEL_CASE)
+#undef KERNEL_CASE
+	default: return calc_l2_dist_batch;
+	}
+}
+
+// -----------------------------------------------------------------------------
+float *new_aligned_floats(			// allocate aligned float array
+	int64_t size)						// number of floats
+{
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, ALIGNMENT, MAX(size, 1) * SIZEFLOAT) != 0) {
+		printf("Could not allocate %ld floats\n", (long) size);
+		exit(1);
+	}
+	return (float*) ptr;
+}
+
+// -----------------------------------------------------------------------------
+Arena::Arena(						// constructor
+	int64_t region_size,				// size of the first region (bytes)
+	bool  hugepage)						// use transparent huge pages?
+	: region_size_(MAX(region_size, (int64_t) ALIGNMENT)), hugepage_(hugepage), 
+	cur_(NULL), left_(0), mapped_(0), used_(0)
+{
+}
+
+// -----------------------------------------------------------------------------
+Arena::~Arena()						// destructor (release all regions)
+{
+	for (auto &region : regions_) munmap(region.first, region.second);
+	regions_.clear();
+}
+
+// -----------------------------------------------------------------------------
+void *Arena::alloc(					// allocate an ALIGNMENT-aligned block
+	int64_t size)						// size (bytes)
+{
+	size = (MAX(size, 1) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+	std::lock_guard<std::mutex> lock(mtx_);
+
+	if (size > left_) {
+		// map a new region (the rest of the last one is left unused); pages 
+		// are only backed by memory once they are touched
+		int64_t page = hugepage_ ? HUGE_PAGE : (int64_t) sysconf(_SC_PAGESIZE);
+		int64_t len  = (MAX(region_size_, size) + page - 1) / page * page;
+
+		void *ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, 
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (ptr == MAP_FAILED) {
+			printf("Could not map %ld bytes\n", (long) len);
+			exit(1);
+		}
+#ifdef MADV_HUGEPAGE
+		if (hugepage_) madvise(ptr, len, MADV_HUGEPAGE);
+#endif
+		regions_.push_back(std::make_pair((char*) ptr, len));
+		cur_     = (char*) ptr;
+		left_    = len;
+		mapped_ += len;
+	}
+	void *ret = cur_;
+	cur_  += size;
+	left_ -= size;
+	used_ += size;
+
+	return ret;
+}
+
+// -----------------------------------------------------------------------------
+void delete_aligned_floats(			// release aligned float array
+	float *arr)							// aligned float array
+{
+	free(arr);
+}
+
+// -----------------------------------------------------------------------------
+float *pack_data(					// copy the indexed points contiguously
+	int   n,							// number of points
+	int   d,							// dimensionality
+	const int   *index,					// index of points
+	const float *data,					// data objects
+	float *packed)						// target (NULL: new_aligned_floats())
+{
+	if (packed == NULL) packed = new_aligned_floats((int64_t) n * d);
+	for (int i = 0; i < n; ++i) {
+		int id = index ? index[i] : i;
+		memcpy(&packed[(int64_t) i*d], &data[(int64_t) id*d], d * SIZEFLOAT);
+	}
+	return packed;
 }
 
 // -----------------------------------------------------------------------------
@@ -112,11 +619,21 @@ float calc_inner_product(			// calc inner product (data type is float)
 	const float *p1,					// 1st point
 	const float *p2)					// 2nd point
 {
-	float ret = 0.0F;
-	for (int i = 0; i < dim; ++i) {
-		ret += p1[i] * p2[i];
+	return inner_product_kernel<0>(dim, p1, p2);
+}
+
+// -----------------------------------------------------------------------------
+float calc_ratio(					// calc overall ratio
+	int   k,							// top-k value
+	const Result *R,					// ground truth results 
+	MaxK_List *list)					// results returned by algorithms
+{
+	float ratio = 0.0f;
+	for (int j = 0; j < k; ++j) {
+		if (fabs(list->ith_key(j) - R[j].key_) < CHECK_ERROR) ratio += 1.0f;
+		else ratio += R[j].key_ / list->ith_key(j);
 	}
-	return ret;
+	return ratio / k;
 }
 
 // -----------------------------------------------------------------------------
@@ -196,8 +713,9 @@ int k_fn_search(					// k-FN search
 	// -------------------------------------------------------------------------
 	//  k-FN search by linear scan
 	// -------------------------------------------------------------------------
+	Dist_Func l2_dist = get_l2_dist_func(d);
 	for (int j = 0; j < n; ++j) {
-		float dist = calc_l2_dist(d, &data[j*d], query);
+		float dist = l2_dist(d, &data[j*d], query);
 		list->insert(dist, j + 1);
 	}
 	return n;
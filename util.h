@@ -4,16 +4,31 @@
 #include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
 #include <cstring>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <new>
 
 #include <unistd.h>
 #include <stdarg.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "def.h"
 #include "pri_queue.h"
+#include "trace.h"
 
 struct Result;
 class  MaxK_List;
@@ -29,12 +44,158 @@ extern float g_ratio;				// global param: overall ratio
 extern float g_recall;				// global param: recall (%)
 extern float g_fraction;			// global param: fraction (%)
 
+extern bool  g_dump_latency;		// global param: dump per-query latency?
+extern int   g_group;				// global param: number of interleaved queries
+extern int   g_proj;				// global param: projection family
+extern bool  g_stream;				// global param: stream data into the build?
+extern bool  g_hugepage;			// global param: arenas on huge pages?
+extern int   g_budget;				// global param: candidate budget per query
+extern float g_deadline;			// global param: deadline per query (ms)
+extern int   g_n_threshold;			// global param: max #objects scanned exactly
+
+// -----------------------------------------------------------------------------
+//  Latency: distribution of per-query latency (ms)
+// -----------------------------------------------------------------------------
+struct Latency {
+	float mean_;
+	float min_;
+	float p50_;
+	float p90_;
+	float p99_;
+	float p999_;
+	float max_;
+};
+
+// -----------------------------------------------------------------------------
+//  Mem_Phase: measured memory usage of one phase (MEM_LOAD, ...), in MB. The 
+//  heap bytes are counted by a global operator new, which is compiled in by 
+//  -DRQALSH_MEMCOUNT (make MEMCOUNT=1); otherwise they are -1.
+// -----------------------------------------------------------------------------
+struct Mem_Phase {
+	float rss_;						// RSS at the end of the phase (-1: n/a)
+	float peak_rss_;				// peak RSS during the phase
+	float heap_;					// heap allocated in the phase, still live
+	float peak_heap_;				// peak heap allocated in the phase
+};
+
+extern Mem_Phase g_mem[MEM_PHASES];	// global param: memory usage of phases
+
+// -----------------------------------------------------------------------------
+//  Arena: a bump allocator which owns the memory of one index in a few large 
+//  regions mapped by mmap (and advised to use transparent huge pages if 
+//  required). The blocks are never freed one by one: all of them are 
+//  released at once when the arena is deleted, so an index with thousands of 
+//  parts is torn down by a few munmap() calls, and its parts are contiguous.
+// -----------------------------------------------------------------------------
+class Arena {
+public:
+	Arena(							// constructor
+		int64_t region_size,			// size of the first region (bytes)
+		bool  hugepage);				// use transparent huge pages?
+
+	// -------------------------------------------------------------------------
+	~Arena();						// destructor (release all regions)
+
+	// -------------------------------------------------------------------------
+	void *alloc(					// allocate an ALIGNMENT-aligned block
+		int64_t size);					// size (bytes)
+
+	// -------------------------------------------------------------------------
+	template<class T>
+	inline T *alloc_array(			// allocate an array of n objects
+		int64_t n)						// number of objects
+	{
+		return (T*) alloc(n * (int64_t) sizeof(T));
+	}
+
+	// -------------------------------------------------------------------------
+	inline int64_t get_memory_usage() const // get mapped memory (bytes)
+	{
+		return mapped_;
+	}
+
+	// -------------------------------------------------------------------------
+	inline int64_t get_used() const	// get allocated memory (bytes)
+	{
+		return used_;
+	}
+
+protected:
+	int64_t region_size_;			// size of the next region (bytes)
+	bool    hugepage_;				// use transparent huge pages?
+	std::mutex mtx_;				// lock of alloc() (parallel builds)
+	std::vector<std::pair<char*, int64_t> > regions_; // regions and sizes
+	char    *cur_;					// next free byte in the last region
+	int64_t left_;					// free bytes in the last region
+	int64_t mapped_;				// mapped memory (bytes)
+	int64_t used_;					// allocated memory (bytes)
+};
+
 // -----------------------------------------------------------------------------
 //  uitlity functions
 // -----------------------------------------------------------------------------
 void create_dir(					// create directory
 	char *path);						// input path
 
+// -----------------------------------------------------------------------------
+inline double get_cur_time()		// monotonic wall-clock time (ms)
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000.0 + ts.tv_nsec / 1000000.0;
+}
+
+// -----------------------------------------------------------------------------
+void calc_latency(					// calc latency distribution
+	int   n,							// number of queries
+	double *lat,						// per-query latency (ms, sorted on return)
+	Latency &res);						// latency distribution (return)
+
+// -----------------------------------------------------------------------------
+int64_t get_rss(					// get resident set size (bytes, -1: n/a)
+	bool  peak);						// peak (VmHWM) or current (VmRSS)?
+
+// -----------------------------------------------------------------------------
+void begin_mem_phase(				// begin a phase of memory measurement
+	int   phase);						// phase (MEM_LOAD, ...)
+
+// -----------------------------------------------------------------------------
+void end_mem_phase(					// end a phase of memory measurement
+	int   phase);						// phase (MEM_LOAD, ...)
+
+// -----------------------------------------------------------------------------
+void display_mem(					// display measured and estimated memory
+	FILE  *fp);							// output file
+
+// -----------------------------------------------------------------------------
+inline void prefetch_data(			// prefetch a memory region into cache
+	const void *addr,					// start address
+	int   size)							// size of region (bytes)
+{
+	const char *p = (const char*) addr;
+	for (int i = 0; i < size; i += CACHE_LINE) __builtin_prefetch(p + i);
+}
+
+// -----------------------------------------------------------------------------
+inline int get_num_threads()		// number of threads for parallel regions
+{
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+inline int get_thread_id()			// id of current thread
+{
+#ifdef _OPENMP
+	return omp_get_thread_num();
+#else
+	return 0;
+#endif
+}
+
 // -----------------------------------------------------------------------------
 int read_bin_data(					// read data (binary) from disk
 	int   n,							// number of data objects
@@ -43,6 +204,32 @@ int read_bin_data(					// read data (binary) from disk
 	const char *fname,					// address of data
 	float *data);						// data (return)
 
+// -----------------------------------------------------------------------------
+//  read data (binary) from disk in chunks of <chunk> objects by a reader 
+//  thread, and call consume(s, e) on the calling thread as soon as objects 
+//  [s, e) are in <data>, so the build of one chunk overlaps the read of the 
+//  next ones
+// -----------------------------------------------------------------------------
+int stream_bin_data(				// stream data (binary) from disk
+	int   n,							// number of data objects
+	int   d,							// dimensionality
+	int   chunk,						// number of objects per chunk
+	const char *fname,					// address of data
+	float *data,						// data (return)
+	const std::function<void(int, int)> &consume); // consume objects [s, e)
+
+// -----------------------------------------------------------------------------
+//  add the sorted run [runs.back(), e) to a stack of adjacent sorted runs: 
+//  the top two runs are merged by merge(lo, mid, hi) while the lower one is 
+//  not longer than the upper one (all of them if <last>), so each object 
+//  takes part in O(log n) merges
+// -----------------------------------------------------------------------------
+void add_sorted_run(				// add a sorted run and merge runs
+	int   e,							// end of the new run
+	bool  last,							// is it the last run?
+	std::vector<int> &runs,				// start of runs, then end (return)
+	const std::function<void(int, int, int)> &merge); // merge [lo,mid),[mid,hi)
+
 // -----------------------------------------------------------------------------
 int read_ground_truth(				// read ground truth results from disk
 	int    qn,							// number of query objects
@@ -55,12 +242,69 @@ float calc_l2_dist(					// calc L_2 norm (data type is float)
 	const float *p1,					// 1st point
 	const float *p2);					// 2nd point
 
+// -----------------------------------------------------------------------------
+void calc_l2_dist_batch(			// calc L_2 norm of a batch of points
+	int   n,							// number of points in the batch
+	int   dim,							// dimension
+	const float *query,					// query point
+	const float *data,					// contiguous points (n * dim)
+	float *dist);						// L_2 norm of each point (return)
+
+// -----------------------------------------------------------------------------
+float *new_aligned_floats(			// allocate aligned float array
+	int64_t size);						// number of floats
+
+// -----------------------------------------------------------------------------
+void delete_aligned_floats(			// release aligned float array
+	float *arr);						// aligned float array
+
+// -----------------------------------------------------------------------------
+float *pack_data(					// copy the indexed points contiguously
+	int   n,							// number of points
+	int   d,							// dimensionality
+	const int   *index,					// index of points
+	const float *data,					// data objects
+	float *packed = NULL);				// target (NULL: new_aligned_floats())
+
 // -----------------------------------------------------------------------------
 float calc_inner_product(			// calc inner product (data type is float)
 	int   dim,							// dimension
 	const float *p1,					// 1st point
 	const float *p2);					// 2nd point
 
+// -----------------------------------------------------------------------------
+//  dimension-specialized kernels: each dimension in KERNEL_DIMS (def.h) has 
+//  its own instance of calc_l2_dist(), calc_inner_product() and 
+//  calc_l2_dist_batch() with the dimension known at compile time, whose 
+//  loops are unrolled over 8 independent accumulators and vectorized; the 
+//  other dimensions get the generic ones. The order of summation differs 
+//  from the generic kernels, so the same kernel must be used for the truth 
+//  set and for the search (a truth set by the generic kernel may be off by 
+//  one ulp, which counts as a miss in calc_recall()). Truth sets made before 
+//  these kernels were added must be regenerated for Mnist (50), Sift (128) 
+//  and Gist (960), and again whenever KERNEL_DIMS changes.
+// -----------------------------------------------------------------------------
+typedef float (*Dist_Func)(int, const float*, const float*);
+typedef void (*Batch_Func)(int, int, const float*, const float*, float*);
+
+// -----------------------------------------------------------------------------
+Dist_Func get_l2_dist_func(			// get calc_l2_dist() for a dimension
+	int   dim);							// dimension
+
+// -----------------------------------------------------------------------------
+Dist_Func get_inner_product_func(	// get calc_inner_product() for a dimension
+	int   dim);							// dimension
+
+// -----------------------------------------------------------------------------
+Batch_Func get_l2_dist_batch_func(	// get calc_l2_dist_batch() for a dimension
+	int   dim);							// dimension
+
+// -----------------------------------------------------------------------------
+float calc_ratio(					// calc overall ratio
+	int   k,							// top-k value
+	const Result *R,					// ground truth results 
+	MaxK_List *list);					// results returned by algorithms
+
 // -----------------------------------------------------------------------------
 float calc_recall(					// calc recall (percentage)
 	int   k,							// top-k value